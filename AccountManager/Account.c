@@ -13,15 +13,27 @@
 #include "HeapManager.h"
 
 #include "PingPongBuffer.h"
+#include "RingBuffer.h"
 #include "Account.h"
 #include <string.h>
 
 #define _MALLOC heap_mgr_malloc
+#define _CALLOC heap_mgr_calloc
+#define _ALIGNED_CALLOC heap_mgr_aligned_calloc // skips the clear when the heap knows the block is zero
+#define _REALLOC heap_mgr_realloc
 #define _FREE heap_mgr_free
 
 #define ACCOUNT_DISCARD_READ_DATA 1
+#ifndef ACCOUNT_BUFFER_ALIGN
+#define ACCOUNT_BUFFER_ALIGN 64 // Buffers of at least this size start on a cache line, 0 : always packed
+#endif
 
 static Account *AccountManager_searchAccount(AccountPoolList *node, const char *ID);
+static Account *AccountManager_findAccount(const char *ID);
+static bool AccountManager_indexInsert(Account *account);
+static void AccountManager_indexRemove(Account *account);
+static bool AccountManager_slotAlloc(Account *account);
+static void AccountManager_slotFree(Account *account);
 static AccountManager *g_accountManager = NULL;
 /**
  * @brief  Initlize the account manager
@@ -65,23 +77,44 @@ void AccountManager_DeInit()
         _FREE(node);
         node = tempNode;
     }
+    _FREE(g_accountManager->Index);
+    _FREE(g_accountManager->Slots);
     _FREE(g_accountManager);
     g_accountManager = NULL;
 }
 /**
  * @brief  Create a account
- * @param  buffer
- * @param  size
- * @retval size
+ * @param  id : kept by pointer, must stay valid
+ * @param  bufSize : ping-pong buffer size, 0 : no cache
+ * @param  userData
+ * @retval Handle for the *H functions, 0 if failed
  */
-bool AccountManager_CreateAccount(const char *id, uint32_t bufSize, void *userData)
+AccountHandle AccountManager_CreateAccount(const char *id, uint32_t bufSize, void *userData)
+{
+    return AccountManager_CreateAccountEx(id, bufSize, 2, RING_BUFFER_LATEST, userData);
+}
+/**
+ * @brief  Create a account with a N slot cache
+ * @param  id : kept by pointer, must stay valid
+ * @param  bufSize : slot size, 0 : no cache
+ * @param  depth : slots, 2 + RING_BUFFER_LATEST is the ping-pong buffer
+ * @param  mode : RING_BUFFER_LATEST or RING_BUFFER_QUEUE
+ * @param  userData
+ * @retval Handle for the *H functions, 0 if failed
+ */
+AccountHandle AccountManager_CreateAccountEx(const char *id, uint32_t bufSize, uint8_t depth,
+                                             RingBufferMode_t mode, void *userData)
 {
-    AccountPoolList *node = g_accountManager->Head;
     // Check if the account has not been created
-    if (AccountManager_searchAccount(node, id) != NULL)
+    if (AccountManager_findAccount(id) != NULL)
     {
         DC_LOG_ERROR("Account[%s] has already created !!!!!!", id);
-        return false;
+        return 0;
+    }
+    if (bufSize != 0 && depth < (mode == RING_BUFFER_QUEUE ? 1 : 2))
+    {
+        DC_LOG_ERROR("Account[%s] cache depth %d not supported", id, depth);
+        return 0;
     }
 
     // 1. Allocate Account Struct
@@ -89,7 +122,7 @@ bool AccountManager_CreateAccount(const char *id, uint32_t bufSize, void *userDa
     if (account == NULL)
     {
         DC_LOG_ERROR("Malloc account failed");
-        return false;
+        return 0;
     }
     memset(account, 0, sizeof(Account));
 
@@ -102,18 +135,37 @@ bool AccountManager_CreateAccount(const char *id, uint32_t bufSize, void *userDa
     void *buffer_mem = NULL;
     if (bufSize != 0)
     {
-        buffer_mem = _MALLOC(bufSize * sizeof(uint8_t) * 2);
+        // Small buffers are packed, a cache line stride would cost more than the buffer itself
+#if (ACCOUNT_BUFFER_ALIGN > 0)
+        bool aligned = ACCOUNT_BUFFER_ALIGN > sizeof(void *) && bufSize >= ACCOUNT_BUFFER_ALIGN;
+#else
+        bool aligned = false;
+#endif
+        uint32_t align = aligned ? ACCOUNT_BUFFER_ALIGN : sizeof(void *);
+        uint32_t bufStride = (bufSize + align - 1) & ~(align - 1);
+        bool useRing = depth != 2 || mode != RING_BUFFER_LATEST;
+        // The ring state goes in front of the slots, in the same block
+        uint32_t ringStride = useRing ? (sizeof(RingBuffer_t) + align - 1) & ~(align - 1) : 0;
+        uint32_t memSize = ringStride + bufStride * sizeof(uint8_t) * depth;
+        buffer_mem = aligned ? _ALIGNED_CALLOC(align, memSize) : _CALLOC(1, memSize);
         if (buffer_mem == NULL)
         {
             DC_LOG_ERROR("Malloc buffer failed");
             goto ErrorHandler_FreeAccount;
         }
-        memset(buffer_mem, 0, bufSize * sizeof(uint8_t) * 2);
 
-        uint8_t *buf0 = (uint8_t *)buffer_mem;
-        uint8_t *buf1 = (uint8_t *)buffer_mem + bufSize;
-        PingPongBuffer_Init(&account->BufferManager, buf0, buf1);
-        DC_LOG_INFO("Account[%s] cached %d x2 bytes", id, bufSize);
+        if (useRing)
+        {
+            account->Ring = (RingBuffer_t *)buffer_mem;
+            RingBuffer_Init(account->Ring, (uint8_t *)buffer_mem + ringStride, bufStride, depth, mode);
+        }
+        else
+        {
+            uint8_t *buf0 = (uint8_t *)buffer_mem;
+            uint8_t *buf1 = (uint8_t *)buffer_mem + bufStride;
+            PingPongBuffer_Init(&account->BufferManager, buf0, buf1);
+        }
+        DC_LOG_INFO("Account[%s] cached %d x%d bytes", id, bufSize, depth);
     }
 
     // 3. Allocate List Node
@@ -127,7 +179,22 @@ bool AccountManager_CreateAccount(const char *id, uint32_t bufSize, void *userDa
     newList->account = account;
     newList->next = NULL;
 
-    // 4. Link to Manager
+    // 4. Index the ID, give a handle
+    if (!AccountManager_slotAlloc(account))
+    {
+        DC_LOG_ERROR("Malloc account handle failed");
+        _FREE(newList);
+        goto ErrorHandler_FreeBuffer;
+    }
+    if (!AccountManager_indexInsert(account))
+    {
+        DC_LOG_ERROR("Malloc account index failed");
+        AccountManager_slotFree(account);
+        _FREE(newList);
+        goto ErrorHandler_FreeBuffer;
+    }
+
+    // 5. Link to Manager
     if (g_accountManager->Head == NULL)
     {
         g_accountManager->Head = newList;
@@ -139,7 +206,7 @@ bool AccountManager_CreateAccount(const char *id, uint32_t bufSize, void *userDa
     g_accountManager->Tail = newList;
     g_accountManager->AccountNumber++;
 
-    return true;
+    return account->Handle;
 
 // Error Handling / Cleanup
 ErrorHandler_FreeBuffer:
@@ -148,7 +215,7 @@ ErrorHandler_FreeBuffer:
 
 ErrorHandler_FreeAccount:
     _FREE(account);
-    return false;
+    return 0;
 }
 
 static bool AcctManager_accountPoolNodeDelete(AccountPoolList *node, const char *id)
@@ -219,7 +286,7 @@ static bool AcctManager_accountPoolNodeDelete(AccountPoolList *node, const char
 
 bool AccountManager_DeleteAccount(const char *id)
 {
-    Account *accountToDelete = AccountManager_searchAccount(g_accountManager->Head, id);
+    Account *accountToDelete = AccountManager_findAccount(id);
     if (!accountToDelete)
     {
         DC_LOG_ERROR("Account[%s] not found for deletion", id);
@@ -227,7 +294,11 @@ bool AccountManager_DeleteAccount(const char *id)
     }
 
     // 1. Free Buffer Memory
-    if (accountToDelete->BufferSize > 0 && accountToDelete->BufferManager.buffer[0])
+    if (accountToDelete->Ring)
+    {
+        _FREE(accountToDelete->Ring);
+    }
+    else if (accountToDelete->BufferSize > 0 && accountToDelete->BufferManager.buffer[0])
     {
         _FREE(accountToDelete->BufferManager.buffer[0]);
     }
@@ -319,6 +390,8 @@ bool AccountManager_DeleteAccount(const char *id)
     }
 
     // 5. Finally Free the Account Struct
+    AccountManager_indexRemove(accountToDelete);
+    AccountManager_slotFree(accountToDelete);
     _FREE(accountToDelete);
     g_accountManager->AccountNumber--;
     
@@ -326,18 +399,196 @@ bool AccountManager_DeleteAccount(const char *id)
     return true;
 }
 
+/**
+ * @brief  Search an account in a publisher / subscriber list
+ * @param  node : list head
+ * @param  ID
+ * @retval Account, NULL if not in the list
+ */
 static Account *AccountManager_searchAccount(AccountPoolList *node, const char *ID)
 {
-    Account *account = NULL;
     while (node != NULL) // check if it is the last node
     {
         if (strcmp(node->account->ID, ID) == 0)
         {
-            account = node->account;
+            return node->account;
         }
         node = node->next;
     }
-    return account;
+    return NULL;
+}
+/**
+ * @brief  FNV-1a hash of an account ID
+ * @param  ID
+ * @retval hash
+ */
+static uint32_t AccountManager_hashID(const char *ID)
+{
+    uint32_t hash = 2166136261u;
+    while (*ID)
+    {
+        hash ^= (uint8_t)*ID++;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+/**
+ * @brief  Find an account by ID in the hash index, O(1)
+ * @param  ID
+ * @retval Account, NULL if not created
+ */
+static Account *AccountManager_findAccount(const char *ID)
+{
+    if (g_accountManager->Index == NULL || ID == NULL)
+    {
+        return NULL;
+    }
+    uint32_t hash = AccountManager_hashID(ID);
+    uint32_t mask = g_accountManager->IndexSize - 1;
+    for (uint32_t slot = hash & mask;; slot = (slot + 1) & mask)
+    {
+        Account *account = g_accountManager->Index[slot];
+        if (account == NULL)
+        {
+            return NULL; // end of the probe sequence
+        }
+        if (account->IDHash == hash && strcmp(account->ID, ID) == 0)
+        {
+            return account;
+        }
+    }
+}
+/**
+ * @brief  Put an account in its slot, the index has room
+ * @param  index
+ * @param  mask : slots - 1
+ * @param  account
+ * @retval void
+ */
+static void AccountManager_indexPlace(Account **index, uint32_t mask, Account *account)
+{
+    uint32_t slot = account->IDHash & mask;
+    while (index[slot] != NULL)
+    {
+        slot = (slot + 1) & mask;
+    }
+    index[slot] = account;
+}
+/**
+ * @brief  Add an account to the hash index, grow it at 3/4 load
+ * @param  account : IDHash is set here
+ * @retval true if success
+ */
+static bool AccountManager_indexInsert(Account *account)
+{
+    account->IDHash = AccountManager_hashID(account->ID);
+    uint32_t size = g_accountManager->IndexSize;
+    if ((g_accountManager->AccountNumber + 1) * 4 > size * 3)
+    {
+        uint32_t newSize = size ? size * 2 : ACCOUNT_INDEX_MIN_SIZE;
+        Account **index = (Account **)_MALLOC(newSize * sizeof(Account *));
+        if (index == NULL)
+        {
+            return false;
+        }
+        memset(index, 0, newSize * sizeof(Account *));
+        for (uint32_t i = 0; i < size; i++)
+        {
+            if (g_accountManager->Index[i] != NULL)
+            {
+                AccountManager_indexPlace(index, newSize - 1, g_accountManager->Index[i]);
+            }
+        }
+        _FREE(g_accountManager->Index);
+        g_accountManager->Index = index;
+        g_accountManager->IndexSize = newSize;
+    }
+    AccountManager_indexPlace(g_accountManager->Index, g_accountManager->IndexSize - 1, account);
+    return true;
+}
+/**
+ * @brief  Remove an account from the hash index, the probe sequences stay unbroken without tombstones
+ * @param  account
+ * @retval void
+ */
+static void AccountManager_indexRemove(Account *account)
+{
+    Account **index = g_accountManager->Index;
+    uint32_t mask = g_accountManager->IndexSize - 1;
+    uint32_t hole = account->IDHash & mask;
+    while (index[hole] != account)
+    {
+        hole = (hole + 1) & mask;
+    }
+    index[hole] = NULL;
+    // Shift back the following entries that probed past the hole
+    for (uint32_t slot = (hole + 1) & mask; index[slot] != NULL; slot = (slot + 1) & mask)
+    {
+        uint32_t home = index[slot]->IDHash & mask;
+        if (((slot - home) & mask) >= ((slot - hole) & mask))
+        {
+            index[hole] = index[slot];
+            index[slot] = NULL;
+            hole = slot;
+        }
+    }
+}
+/**
+ * @brief  Give an account a handle slot, reuse freed slots first
+ * @param  account : Handle is set here
+ * @retval true if success
+ */
+static bool AccountManager_slotAlloc(Account *account)
+{
+    uint32_t index;
+    if (g_accountManager->FreeSlot != 0)
+    {
+        index = g_accountManager->FreeSlot - 1u;
+        g_accountManager->FreeSlot = g_accountManager->Slots[index].NextFree;
+    }
+    else
+    {
+        if (g_accountManager->SlotNum == g_accountManager->SlotCapacity)
+        {
+            uint32_t capacity = g_accountManager->SlotCapacity ? g_accountManager->SlotCapacity * 2u : ACCOUNT_INDEX_MIN_SIZE;
+            if (capacity > 0xFFFF)
+            {
+                capacity = 0xFFFF; // index + 1 must fit in 16 bits
+            }
+            if (capacity == g_accountManager->SlotNum)
+            {
+                return false;
+            }
+            AccountSlot *slots = (AccountSlot *)_REALLOC(g_accountManager->Slots, capacity * sizeof(AccountSlot));
+            if (slots == NULL)
+            {
+                return false;
+            }
+            g_accountManager->Slots = slots;
+            g_accountManager->SlotCapacity = (uint16_t)capacity;
+        }
+        index = g_accountManager->SlotNum++;
+        g_accountManager->Slots[index].Generation = 0;
+    }
+    AccountSlot *slot = &g_accountManager->Slots[index];
+    slot->account = account;
+    slot->NextFree = 0;
+    account->Handle = ((AccountHandle)slot->Generation << 16) | (index + 1u);
+    return true;
+}
+/**
+ * @brief  Release the handle slot of an account, its handles stop resolving
+ * @param  account
+ * @retval void
+ */
+static void AccountManager_slotFree(Account *account)
+{
+    uint32_t index = (account->Handle & 0xFFFF) - 1u;
+    AccountSlot *slot = &g_accountManager->Slots[index];
+    slot->account = NULL;
+    slot->Generation++;
+    slot->NextFree = g_accountManager->FreeSlot;
+    g_accountManager->FreeSlot = (uint16_t)(index + 1u);
 }
 /**
  * @brief  Log account from the pool
@@ -350,7 +601,7 @@ void AccountManager_LogAccount(const char *id)
     uint32_t num = 0;
     if (id)
     {
-        Account *account = AccountManager_searchAccount(g_accountManager->Head, id);
+        Account *account = AccountManager_findAccount(id);
         if (account)
         {
             DC_LOG_INFO("Account [%s]Log all followers", id);
@@ -404,8 +655,7 @@ void AccountManager_LogAccount(const char *id)
  */
 bool Account_registerCb(const char *id, EventCallback_t eventCb)
 {
-    AccountPoolList *node = g_accountManager->Head;
-    Account *account = AccountManager_searchAccount(node, id);
+    Account *account = AccountManager_findAccount(id);
     if (account)
     {
         account->eventCb = eventCb;
@@ -427,8 +677,8 @@ bool Account_subscribe(const char *accountID, const char *subID)
         DC_LOG_ERROR("Can not subscribe itseft");
         return false;
     }
-    Account *Subscriber = AccountManager_searchAccount(g_accountManager->Head, accountID);
-    Account *account = AccountManager_searchAccount(g_accountManager->Head, subID);
+    Account *Subscriber = AccountManager_findAccount(accountID);
+    Account *account = AccountManager_findAccount(subID);
     AccountPoolList *node = NULL;
 
     if (Subscriber && account) // Check if the account is created or not
@@ -507,8 +757,8 @@ bool Account_unsubscribe(const char *accountID, const char *subID)
         DC_LOG_ERROR("Can not unsubscribe itseft");
         return false;
     }
-    Account *Subscriber = AccountManager_searchAccount(g_accountManager->Head, accountID);
-    Account *account = AccountManager_searchAccount(g_accountManager->Head, subID);
+    Account *Subscriber = AccountManager_findAccount(accountID);
+    Account *account = AccountManager_findAccount(subID);
     AccountPoolList *node = NULL;
     AccountPoolList *preNode = NULL;
     AccountPoolList *nextNode = NULL;
@@ -595,68 +845,171 @@ bool Account_unsubscribe(const char *accountID, const char *subID)
 }
 
 /**
- * @brief  unsubscribe account
- * @param  accountID :
- * @retval true if success
+ * @brief  Cache access, ring buffer or ping-pong buffer
  */
-bool Account_commit(const char *id, const void *data_p, uint32_t size)
+static bool Account_getWriteBuf(Account *account, void **pWriteBuf)
 {
-    AccountPoolList *node = g_accountManager->Head;
-    Account *account = AccountManager_searchAccount(node, id);
-    if (account)
+    if (account->Ring)
+        return RingBuffer_GetWriteBuf(account->Ring, pWriteBuf);
+    PingPongBuffer_GetWriteBuf(&account->BufferManager, pWriteBuf);
+    return true;
+}
+static void Account_setWriteDone(Account *account)
+{
+    if (account->Ring)
+        RingBuffer_SetWriteDone(account->Ring);
+    else
+        PingPongBuffer_SetWriteDone(&account->BufferManager);
+}
+static bool Account_getReadBuf(Account *account, void **pReadBuf)
+{
+    if (account->Ring)
+        return RingBuffer_GetReadBuf(account->Ring, pReadBuf);
+    return PingPongBuffer_GetReadBuf(&account->BufferManager, pReadBuf);
+}
+static void Account_setReadDone(Account *account)
+{
+    if (account->Ring)
+        RingBuffer_SetReadDone(account->Ring);
+    else
+        PingPongBuffer_SetReadDone(&account->BufferManager);
+}
+/**
+ * @brief  Buffer held by the read loans
+ */
+static void *Account_getLoanedBuf(Account *account)
+{
+    if (account->Ring)
+        return account->Ring->buffer + (uint32_t)account->Ring->readIndex * account->Ring->slotSize;
+    return account->BufferManager.buffer[account->BufferManager.readIndex];
+}
+/**
+ * @brief  Check if an account is in a publisher / subscriber list
+ * @param  node : list head
+ * @param  account
+ * @retval true if found
+ */
+static bool AccountManager_hasAccount(AccountPoolList *node, const Account *account)
+{
+    while (node != NULL)
     {
-        if (!size || size != account->BufferSize)
+        if (node->account == account)
         {
-            DC_LOG_ERROR("pub[%s] has not cache", id);
-            return false;
+            return true;
         }
-        void *wBuf;
-        PingPongBuffer_GetWriteBuf(&account->BufferManager, &wBuf);
-        memcpy(wBuf, data_p, size);
-        PingPongBuffer_SetWriteDone(&account->BufferManager);
-        DC_LOG_INFO("pub[%s] commit data(0x%p)[%d] >> data(0x%p)[%d] done",
-                    id, data_p, size, wBuf, size);
-        return true;
+        node = node->next;
     }
+    return false;
 }
 /**
- * @brief  Publish data to subscribers
- * @param  None
- * @retval error code
+ * @brief  Resolve a handle, O(1)
+ * @param  handle
+ * @retval Account, NULL if the handle is invalid or the account was deleted
  */
-int Account_publish(const char *id)
+static Account *AccountManager_resolve(AccountHandle handle)
 {
-    int retval = RES_UNKNOW;
-    AccountPoolList *node = g_accountManager->Head;
-    Account *account = AccountManager_searchAccount(node, id);
+    uint32_t index = (handle & 0xFFFF) - 1;
+    if (g_accountManager == NULL || index >= g_accountManager->SlotNum)
+    {
+        return NULL;
+    }
+    AccountSlot *slot = &g_accountManager->Slots[index];
+    return slot->Generation == (uint16_t)(handle >> 16) ? slot->account : NULL;
+}
+/**
+ * @brief  Get the handle of an account, to skip the ID lookup in the *H functions
+ * @param  id
+ * @retval handle, 0 if not created
+ */
+AccountHandle AccountManager_getHandle(const char *id)
+{
+    Account *account = AccountManager_findAccount(id);
+    return account ? account->Handle : 0;
+}
+
+static bool Account_commitAccount(Account *account, const void *data_p, uint32_t size)
+{
+    if (!size || size != account->BufferSize)
+    {
+        DC_LOG_ERROR("pub[%s] has not cache", account->ID);
+        return false;
+    }
+    if (account->WriteLoan)
+    {
+        DC_LOG_ERROR("pub[%s] write buffer is loaned", account->ID);
+        return false;
+    }
+    void *wBuf;
+    if (!Account_getWriteBuf(account, &wBuf))
+    {
+        DC_LOG_WARN("pub[%s] cache full, data dropped", account->ID);
+        return false;
+    }
+    memcpy(wBuf, data_p, size);
+    Account_setWriteDone(account);
+    DC_LOG_INFO("pub[%s] commit data(0x%p)[%d] >> data(0x%p)[%d] done",
+                account->ID, data_p, size, wBuf, size);
+    return true;
+}
+/**
+ * @brief  Commit data to the account cache
+ * @param  id
+ * @param  data_p
+ * @param  size : must be the buffer size
+ * @retval true if success
+ */
+bool Account_commit(const char *id, const void *data_p, uint32_t size)
+{
+    Account *account = AccountManager_findAccount(id);
     if (account == NULL)
-        return RES_UNKNOW;
+        return false;
+    return Account_commitAccount(account, data_p, size);
+}
+/**
+ * @brief  Account_commit by handle
+ */
+bool Account_commitH(AccountHandle handle, const void *data_p, uint32_t size)
+{
+    Account *account = AccountManager_resolve(handle);
+    if (account == NULL)
+        return false;
+    return Account_commitAccount(account, data_p, size);
+}
+
+static int Account_publishAccount(Account *account)
+{
+    int retval = RES_UNKNOW;
     if (account->BufferSize == 0)
     {
-        DC_LOG_ERROR("pub[%s] has not cache", id);
+        DC_LOG_ERROR("pub[%s] has not cache", account->ID);
         return RES_NO_CACHE;
     }
+    if (account->ReadLoans)
+    {
+        DC_LOG_WARN("pub[%s] read buffer is loaned", account->ID);
+        return RES_BUSY;
+    }
     void *rBuf;
-    if (!PingPongBuffer_GetReadBuf(&account->BufferManager, &rBuf))
+    if (!Account_getReadBuf(account, &rBuf))
     {
-        DC_LOG_WARN("pub[%s] data was not commit", id);
+        DC_LOG_WARN("pub[%s] data was not commit", account->ID);
         return RES_NO_COMMITED;
     }
     EventParam_t param;
     param.event = EVENT_PUB_PUBLISH;
-    param.tran = id;
+    param.tran = account->ID;
     param.recv = NULL;
     param.data_p = rBuf;
     param.size = account->BufferSize;
     /* Publish messages to subscribers */
-    node = account->subscribers;
+    AccountPoolList *node = account->subscribers;
     while (node)
     {
         if (node->account)
         {
             EventCallback_t callback = node->account->eventCb;
             DC_LOG_INFO("pub[%s] publish >> data(0x%p)[%d] >> sub[%s]...",
-                        id, param.data_p, param.size, node->account->ID);
+                        account->ID, param.data_p, param.size, node->account->ID);
             if (callback != NULL)
             {
                 param.recv = node->account->ID;
@@ -673,85 +1026,157 @@ int Account_publish(const char *id)
         node = node->next;
     }
 #if ACCOUNT_DISCARD_READ_DATA
-    PingPongBuffer_SetReadDone(&account->BufferManager);
+    Account_setReadDone(account);
 #endif
     return retval;
 }
 /**
- * @brief  Pull data from the publisher
- * @param  pubID:  Publisher ID
- * @param  data_p: Pointer to data
- * @param  size:   The size of the data
+ * @brief  Publish data to subscribers
+ * @param  id
  * @retval error code
  */
-int Account_pull(const char *sub, const char *pub, void *data_p, uint32_t size)
+int Account_publish(const char *id)
 {
-    AccountPoolList *node = g_accountManager->Head;
-    Account *account = AccountManager_searchAccount(node, sub);
-    if (account)
+    Account *account = AccountManager_findAccount(id);
+    if (account == NULL)
+        return RES_UNKNOW;
+    return Account_publishAccount(account);
+}
+/**
+ * @brief  Account_publish by handle
+ */
+int Account_publishH(AccountHandle handle)
+{
+    Account *account = AccountManager_resolve(handle);
+    if (account == NULL)
+        return RES_UNKNOW;
+    return Account_publishAccount(account);
+}
+
+static int Account_pullAccount(Account *account, Account *publiser, void *data_p, uint32_t size)
+{
+    // Check if sub already sub the publisher
+    if (publiser == NULL || !AccountManager_hasAccount(account->publishers, publiser))
     {
-        // Check if sub already sub the publisher
-        node = account->publishers;
-        Account *publiser = AccountManager_searchAccount(node, pub);
-        if (publiser == NULL)
-        {
-            DC_LOG_ERROR("sub[%s] was not subscribe pub[%s]", sub, pub);
-            return RES_NOT_FOUND;
-        }
-        int retval = RES_UNKNOW;
-        DC_LOG_INFO("sub[%s] pull << data(0x%p)[%d] << pub[%s] ...",
-                    sub, data_p, size, pub);
-        EventCallback_t callback = publiser->eventCb;
-        if (callback)
+        DC_LOG_ERROR("sub[%s] was not subscribe pub", account->ID);
+        return RES_NOT_FOUND;
+    }
+    int retval = RES_UNKNOW;
+    DC_LOG_INFO("sub[%s] pull << data(0x%p)[%d] << pub[%s] ...",
+                account->ID, data_p, size, publiser->ID);
+    EventCallback_t callback = publiser->eventCb;
+    if (callback)
+    {
+        EventParam_t param;
+        param.event = EVENT_SUB_PULL;
+        param.tran = account->ID;
+        param.recv = publiser->ID;
+        param.data_p = data_p;
+        param.size = size;
+        int ret = callback(publiser, &param);
+        DC_LOG_INFO("pull done: %d", ret);
+        retval = ret;
+    }
+    else
+    {
+        DC_LOG_INFO("pub[%s] not registed pull callback, read commit cache...", publiser->ID);
+        if (publiser->ReadLoans)
         {
-            EventParam_t param;
-            param.event = EVENT_SUB_PULL;
-            param.tran = sub;
-            param.recv = pub;
-            param.data_p = data_p;
-            param.size = size;
-            int ret = callback(publiser, &param);
-            DC_LOG_INFO("pull done: %d", ret);
-            retval = ret;
+            DC_LOG_WARN("pub[%s] read buffer is loaned", publiser->ID);
+            retval = RES_BUSY;
         }
-        else
+        else if (publiser->BufferSize == size)
         {
-            DC_LOG_INFO("pub[%s] not registed pull callback, read commit cache...", pub);
-            if (publiser->BufferSize == size)
+            void *rBuf;
+            if (Account_getReadBuf(publiser, &rBuf))
             {
-                void *rBuf;
-                if (PingPongBuffer_GetReadBuf(&publiser->BufferManager, &rBuf))
-                {
-                    memcpy(data_p, rBuf, size);
+                memcpy(data_p, rBuf, size);
 #if ACCOUNT_DISCARD_READ_DATA
-                    PingPongBuffer_SetReadDone(&publiser->BufferManager);
+                Account_setReadDone(publiser);
 #endif
-                    DC_LOG_INFO("read done");
-                    retval = 0;
-                }
-                else
-                {
-                    DC_LOG_WARN("pub[%s] data was not commit!", pub);
-                }
+                DC_LOG_INFO("read done");
+                retval = 0;
             }
             else
             {
-                DC_LOG_ERROR(
-                    "Data size pub[%s]:%d != sub[%s]:%d",
-                    pub,
-                    publiser->BufferSize,
-                    sub,
-                    size);
+                DC_LOG_WARN("pub[%s] data was not commit!", publiser->ID);
             }
         }
-        return retval;
+        else
+        {
+            DC_LOG_ERROR(
+                "Data size pub[%s]:%d != sub[%s]:%d",
+                publiser->ID,
+                publiser->BufferSize,
+                account->ID,
+                size);
+        }
     }
-    DC_LOG_WARN("Account[%s]is not created!", sub);
+    return retval;
+}
+/**
+ * @brief  Pull data from the publisher
+ * @param  sub:    Subscriber ID
+ * @param  pub:    Publisher ID
+ * @param  data_p: Pointer to data
+ * @param  size:   The size of the data
+ * @retval error code
+ */
+int Account_pull(const char *sub, const char *pub, void *data_p, uint32_t size)
+{
+    Account *account = AccountManager_findAccount(sub);
+    if (account == NULL)
+    {
+        DC_LOG_WARN("Account[%s]is not created!", sub);
+        return RES_UNKNOW;
+    }
+    return Account_pullAccount(account, AccountManager_findAccount(pub), data_p, size);
+}
+/**
+ * @brief  Account_pull by handle
+ */
+int Account_pullH(AccountHandle sub, AccountHandle pub, void *data_p, uint32_t size)
+{
+    Account *account = AccountManager_resolve(sub);
+    if (account == NULL)
+        return RES_UNKNOW;
+    return Account_pullAccount(account, AccountManager_resolve(pub), data_p, size);
+}
 
-    return RES_UNKNOW;
+static int Account_notifyAccount(Account *sub, Account *pub, const void *data_p, uint32_t size)
+{
+    if (pub == NULL || !AccountManager_hasAccount(sub->publishers, pub))
+    {
+        DC_LOG_ERROR("sub[%s] was not subscribe pub", sub->ID);
+        return RES_NOT_FOUND;
+    }
+    int retval = RES_UNKNOW;
+    DC_LOG_INFO("sub[%s] notify >> data(0x%p)[%d] >> pub[%s] ...",
+                sub->ID, data_p, size, pub->ID);
+    EventCallback_t callback = pub->eventCb;
+    if (callback != NULL)
+    {
+        EventParam_t param;
+        param.event = EVENT_NOTIFY;
+        param.tran = sub->ID;
+        param.recv = pub->ID;
+        param.data_p = (void *)data_p;
+        param.size = size;
+        int ret = callback(pub, &param);
+        DC_LOG_INFO("send done: %d", ret);
+        retval = ret;
+    }
+    else
+    {
+        DC_LOG_WARN("pub[%s] not register callback", pub->ID);
+        retval = RES_NO_CALLBACK;
+    }
+
+    return retval;
 }
 /**
  * @brief  Send a notification to the publisher
+ * @param  subID: Subscriber ID
  * @param  pubID: Publisher ID
  * @param  data_p: Pointer to data
  * @param  size:   The size of the data
@@ -759,41 +1184,208 @@ int Account_pull(const char *sub, const char *pub, void *data_p, uint32_t size)
  */
 int Account_notify(const char *subID, const char *pubID, const void *data_p, uint32_t size)
 {
-    AccountPoolList *node = g_accountManager->Head;
-    Account *sub = AccountManager_searchAccount(node, subID);
-    if (sub)
+    Account *sub = AccountManager_findAccount(subID);
+    if (sub == NULL)
     {
-        node = sub->publishers;
-        Account *pub = AccountManager_searchAccount(node, pubID);
-        if (pub == NULL)
-        {
-            DC_LOG_ERROR("sub[%s] was not subscribe pub[%s]", subID, pubID);
-            return RES_NOT_FOUND;
-        }
-        int retval = RES_UNKNOW;
-        DC_LOG_INFO("sub[%s] notify >> data(0x%p)[%d] >> pub[%s] ...",
-                    subID, data_p, size, pubID);
-        EventCallback_t callback = pub->eventCb;
-        if (callback != NULL)
-        {
-            EventParam_t param;
-            param.event = EVENT_NOTIFY;
-            param.tran = subID;
-            param.recv = pubID;
-            param.data_p = (void *)data_p;
-            param.size = size;
-            int ret = callback(pub, &param);
-            DC_LOG_INFO("send done: %d", ret);
-            retval = ret;
-        }
-        else
+        DC_LOG_WARN("Account[%s]is not created!", subID);
+        return RES_UNKNOW;
+    }
+    return Account_notifyAccount(sub, AccountManager_findAccount(pubID), data_p, size);
+}
+/**
+ * @brief  Account_notify by handle
+ */
+int Account_notifyH(AccountHandle sub, AccountHandle pub, const void *data_p, uint32_t size)
+{
+    Account *account = AccountManager_resolve(sub);
+    if (account == NULL)
+        return RES_UNKNOW;
+    return Account_notifyAccount(account, AccountManager_resolve(pub), data_p, size);
+}
+
+static bool Account_beginCommitAccount(Account *account, void **pWriteBuf)
+{
+    if (account->BufferSize == 0)
+    {
+        DC_LOG_ERROR("pub[%s] has not cache", account->ID);
+        return false;
+    }
+    if (account->WriteLoan)
+    {
+        DC_LOG_ERROR("pub[%s] write buffer is already loaned", account->ID);
+        return false;
+    }
+    if (!Account_getWriteBuf(account, pWriteBuf))
+    {
+        DC_LOG_WARN("pub[%s] cache full", account->ID);
+        return false;
+    }
+    account->WriteLoan = true;
+    DC_LOG_INFO("pub[%s] loan write buffer(0x%p)[%d]", account->ID, *pWriteBuf, account->BufferSize);
+    return true;
+}
+/**
+ * @brief  Loan the write buffer to fill it in place instead of Account_commit
+ * @param  id
+ * @param  pWriteBuf : set to the write buffer, BufferSize bytes
+ * @retval true if success
+ */
+bool Account_beginCommit(const char *id, void **pWriteBuf)
+{
+    Account *account = AccountManager_findAccount(id);
+    if (account == NULL || pWriteBuf == NULL)
+        return false;
+    return Account_beginCommitAccount(account, pWriteBuf);
+}
+/**
+ * @brief  Account_beginCommit by handle
+ */
+bool Account_beginCommitH(AccountHandle handle, void **pWriteBuf)
+{
+    Account *account = AccountManager_resolve(handle);
+    if (account == NULL || pWriteBuf == NULL)
+        return false;
+    return Account_beginCommitAccount(account, pWriteBuf);
+}
+
+static bool Account_endCommitAccount(Account *account)
+{
+    if (!account->WriteLoan)
+    {
+        DC_LOG_ERROR("pub[%s] write buffer was not loaned", account->ID);
+        return false;
+    }
+    Account_setWriteDone(account);
+    account->WriteLoan = false;
+    DC_LOG_INFO("pub[%s] commit in place done", account->ID);
+    return true;
+}
+/**
+ * @brief  Give the write buffer back, the data is committed
+ * @param  id
+ * @retval true if success
+ */
+bool Account_endCommit(const char *id)
+{
+    Account *account = AccountManager_findAccount(id);
+    if (account == NULL)
+        return false;
+    return Account_endCommitAccount(account);
+}
+/**
+ * @brief  Account_endCommit by handle
+ */
+bool Account_endCommitH(AccountHandle handle)
+{
+    Account *account = AccountManager_resolve(handle);
+    if (account == NULL)
+        return false;
+    return Account_endCommitAccount(account);
+}
+
+static int Account_pullLoanAccount(Account *account, Account *publiser, const void **pReadBuf, uint32_t size)
+{
+    if (publiser == NULL || !AccountManager_hasAccount(account->publishers, publiser))
+    {
+        DC_LOG_ERROR("sub[%s] was not subscribe pub", account->ID);
+        return RES_NOT_FOUND;
+    }
+    if (publiser->BufferSize == 0)
+    {
+        DC_LOG_ERROR("pub[%s] has not cache", publiser->ID);
+        return RES_NO_CACHE;
+    }
+    if (publiser->BufferSize != size)
+    {
+        DC_LOG_ERROR("Data size pub[%s]:%d != sub[%s]:%d",
+                     publiser->ID, publiser->BufferSize, account->ID, size);
+        return RES_SIZE_MISMATCH;
+    }
+    /* Every loan shares the buffer taken by the first one */
+    if (publiser->ReadLoans)
+    {
+        *pReadBuf = Account_getLoanedBuf(publiser);
+    }
+    else
+    {
+        void *rBuf;
+        if (!Account_getReadBuf(publiser, &rBuf))
         {
-            DC_LOG_WARN("pub[%s] not register callback", pub->ID);
-            retval = RES_NO_CALLBACK;
+            DC_LOG_WARN("pub[%s] data was not commit!", publiser->ID);
+            return RES_NO_COMMITED;
         }
+        *pReadBuf = rBuf;
+    }
+    publiser->ReadLoans++;
+    DC_LOG_INFO("sub[%s] loan << data(0x%p)[%d] << pub[%s]", account->ID, *pReadBuf, size, publiser->ID);
+    return RES_OK;
+}
+/**
+ * @brief  Loan the publisher's read buffer instead of copying it out with Account_pull
+ * @param  sub:    Subscriber ID
+ * @param  pub:    Publisher ID
+ * @param  pReadBuf: set to the read buffer, valid until Account_pullRelease
+ * @param  size:   The size of the data
+ * @retval error code
+ */
+int Account_pullLoan(const char *sub, const char *pub, const void **pReadBuf, uint32_t size)
+{
+    Account *account = AccountManager_findAccount(sub);
+    if (account == NULL || pReadBuf == NULL)
+        return RES_UNKNOW;
+    return Account_pullLoanAccount(account, AccountManager_findAccount(pub), pReadBuf, size);
+}
+/**
+ * @brief  Account_pullLoan by handle
+ */
+int Account_pullLoanH(AccountHandle sub, AccountHandle pub, const void **pReadBuf, uint32_t size)
+{
+    Account *account = AccountManager_resolve(sub);
+    if (account == NULL || pReadBuf == NULL)
+        return RES_UNKNOW;
+    return Account_pullLoanAccount(account, AccountManager_resolve(pub), pReadBuf, size);
+}
 
-        return retval;
+static int Account_pullReleaseAccount(Account *account, Account *publiser)
+{
+    if (publiser == NULL || !AccountManager_hasAccount(account->publishers, publiser))
+    {
+        DC_LOG_ERROR("sub[%s] was not subscribe pub", account->ID);
+        return RES_NOT_FOUND;
     }
-    DC_LOG_WARN("Account[%s]is not created!", sub);
-    return RES_UNKNOW;
+    if (publiser->ReadLoans == 0)
+    {
+        DC_LOG_ERROR("pub[%s] read buffer was not loaned", publiser->ID);
+        return RES_PARAM_ERROR;
+    }
+    if (--publiser->ReadLoans == 0)
+    {
+#if ACCOUNT_DISCARD_READ_DATA
+        Account_setReadDone(publiser);
+#endif
+    }
+    return RES_OK;
+}
+/**
+ * @brief  Release a read buffer loan
+ * @param  sub:    Subscriber ID
+ * @param  pub:    Publisher ID
+ * @retval error code
+ */
+int Account_pullRelease(const char *sub, const char *pub)
+{
+    Account *account = AccountManager_findAccount(sub);
+    if (account == NULL)
+        return RES_UNKNOW;
+    return Account_pullReleaseAccount(account, AccountManager_findAccount(pub));
+}
+/**
+ * @brief  Account_pullRelease by handle
+ */
+int Account_pullReleaseH(AccountHandle sub, AccountHandle pub)
+{
+    Account *account = AccountManager_resolve(sub);
+    if (account == NULL)
+        return RES_UNKNOW;
+    return Account_pullReleaseAccount(account, AccountManager_resolve(pub));
 }
@@ -7,7 +7,10 @@ extern "C"
 {
 #endif
 #include "PingPongBuffer.h"
+#include "RingBuffer.h"
+#ifndef DATA_CENTER_USE_LOG
 #define DATA_CENTER_USE_LOG 1
+#endif
 #if (DATA_CENTER_USE_LOG == 1)
 #include <stdio.h>
 #define _DC_LOG(format, ...) printf("[DC]" format "\r\n", ##__VA_ARGS__)
@@ -19,7 +22,9 @@ extern "C"
 #define DC_LOG_WARN(...)
 #define DC_LOG_ERROR(...)
 #endif
+#define ACCOUNT_INDEX_MIN_SIZE 16 // slots of the ID hash index, power of 2, doubled at 3/4 load
     typedef struct _Account Account;
+    typedef uint32_t AccountHandle; /* Slot index + 1 (low 16 bits) and generation (high 16 bits), 0 is invalid */
     /* Event type enumeration */
     typedef enum
     {
@@ -41,7 +46,8 @@ extern "C"
         RES_NO_CACHE = -5,
         RES_NO_COMMITED = -6,
         RES_NOT_FOUND = -7,
-        RES_PARAM_ERROR = -8
+        RES_PARAM_ERROR = -8,
+        RES_BUSY = -9 // The read buffer is loaned, see Account_pullLoan
     } ResCode_t;
     /* Event parameter structure */
     typedef struct
@@ -62,18 +68,35 @@ extern "C"
     typedef struct _Account
     {
         const char *ID; /* Unique account ID */
+        uint32_t IDHash; /* Hash of the ID, slot in AccountManager Index */
+        AccountHandle Handle;
         void *UserData; /*  account ID */
         uint32_t BufferSize;
         PingPongBuffer_t BufferManager;
+        RingBuffer_t *Ring; /* N slot cache from AccountManager_CreateAccountEx, NULL : BufferManager */
+        uint8_t WriteLoan; /* Write buffer handed out by Account_beginCommit */
+        uint8_t ReadLoans; /* Read buffer loans from Account_pullLoan not released yet */
         EventCallback_t eventCb;
         AccountPoolList *publishers;  /* Followed publishers */
         AccountPoolList *subscribers; /* Followed subscribers */
     } Account;
+    typedef struct
+    {
+        Account *account;    /* NULL if the slot is free */
+        uint16_t Generation; /* Bumped when the account is deleted, old handles stop resolving */
+        uint16_t NextFree;   /* Next free slot index + 1 */
+    } AccountSlot;
     typedef struct _AccountManager
     {
         AccountPoolList *Head;
         AccountPoolList *Tail;
         uint32_t AccountNumber;
+        Account **Index;        /* Open addressing hash index on the IDs, linear probing */
+        uint32_t IndexSize;     /* Slots, power of 2 */
+        AccountSlot *Slots;     /* Handle table */
+        uint16_t SlotNum;       /* Slots in use or freed */
+        uint16_t SlotCapacity;
+        uint16_t FreeSlot;      /* First free slot index + 1, 0 : none */
     } AccountManager;
 
     /**
@@ -90,11 +113,30 @@ extern "C"
     void AccountManager_DeInit();
     /**
      * @brief  Create a account
-     * @param  buffer
-     * @param  size
-     * @retval size
+     * @param  id : kept by pointer, must stay valid
+     * @param  bufSize : ping-pong buffer size, 0 : no cache
+     * @param  userData
+     * @retval Handle for the *H functions, 0 if failed
+     */
+    AccountHandle AccountManager_CreateAccount(const char *id, uint32_t bufSize, void *userData);
+    /**
+     * @brief  Create a account with a N slot cache instead of the ping-pong buffer
+     * @param  id : kept by pointer, must stay valid
+     * @param  bufSize : slot size, 0 : no cache
+     * @param  depth : slots, 2 + RING_BUFFER_LATEST is the ping-pong buffer
+     * @param  mode : RING_BUFFER_LATEST: publish / pull the newest message, 3 slots never block the writer,
+     *                RING_BUFFER_QUEUE: publish / pull every message in order, commit fails when full
+     * @param  userData
+     * @retval Handle for the *H functions, 0 if failed
      */
-    bool AccountManager_CreateAccount(const char *id, uint32_t bufSize, void *userData);
+    AccountHandle AccountManager_CreateAccountEx(const char *id, uint32_t bufSize, uint8_t depth,
+                                                 RingBufferMode_t mode, void *userData);
+    /**
+     * @brief  Get the handle of an account, IDs are only needed at setup
+     * @param  id
+     * @retval Handle, 0 if not created
+     */
+    AccountHandle AccountManager_getHandle(const char *id);
     /**
      * @brief  Delete account
      * @param  id
@@ -129,8 +171,10 @@ extern "C"
      */
     bool Account_unsubscribe(const char *accountID, const char *subID);
     /**
-     * @brief  unsubscribe account
-     * @param  accountID :
+     * @brief  Commit data to the account cache
+     * @param  id
+     * @param  data_p
+     * @param  size : must be the buffer size
      * @retval true if success
      */
     bool Account_commit(const char *id, const void *data_p, uint32_t size);
@@ -156,6 +200,48 @@ extern "C"
      * @retval error code
      */
     int Account_notify(const char *subID, const char *pubID, const void *data_p, uint32_t size);
+    /**
+     * @brief  Loan the write buffer to fill it in place instead of Account_commit
+     * @param  id
+     * @param  pWriteBuf : set to the write buffer, BufferSize bytes
+     * @retval true if success, false if there is no cache or a loan is already open
+     */
+    bool Account_beginCommit(const char *id, void **pWriteBuf);
+    /**
+     * @brief  Give the write buffer back, the data is committed
+     * @param  id
+     * @retval true if success
+     */
+    bool Account_endCommit(const char *id);
+    /**
+     * @brief  Loan the publisher's read buffer instead of copying it out with Account_pull,
+     *         the pull callback is not called. The buffer stays valid until Account_pullRelease,
+     *         commits go to the other buffer meanwhile, publish and cache pulls return RES_BUSY.
+     * @param  sub:    Subscriber ID
+     * @param  pub:    Publisher ID
+     * @param  pReadBuf: set to the read buffer, read only
+     * @param  size:   The size of the data, must be the buffer size
+     * @retval error code
+     */
+    int Account_pullLoan(const char *sub, const char *pub, const void **pReadBuf, uint32_t size);
+    /**
+     * @brief  Release a read buffer loan, the data is discarded once every loan is released
+     * @param  sub:    Subscriber ID
+     * @param  pub:    Publisher ID
+     * @retval error code
+     */
+    int Account_pullRelease(const char *sub, const char *pub);
+    /**
+     * @brief  Handle variants, no ID lookup: O(1), a stale handle fails like an unknown ID
+     */
+    bool Account_commitH(AccountHandle handle, const void *data_p, uint32_t size);
+    int Account_publishH(AccountHandle handle);
+    int Account_pullH(AccountHandle sub, AccountHandle pub, void *data_p, uint32_t size);
+    int Account_notifyH(AccountHandle sub, AccountHandle pub, const void *data_p, uint32_t size);
+    bool Account_beginCommitH(AccountHandle handle, void **pWriteBuf);
+    bool Account_endCommitH(AccountHandle handle);
+    int Account_pullLoanH(AccountHandle sub, AccountHandle pub, const void **pReadBuf, uint32_t size);
+    int Account_pullReleaseH(AccountHandle sub, AccountHandle pub);
 #ifdef __cplusplus
 }
 #endif
@@ -23,6 +23,25 @@
 #include "PingPongBuffer.h"
 #include <string.h>
 
+/* state bits, every transition is one CAS so the reader and the writer never
+ * pick the same buffer: the writer takes the one the reader does not hold,
+ * the reader only takes the latest buffer while it is fresh (written and not being rewritten) */
+#define PPBUF_LATEST 0x01     // index of the last written buffer
+#define PPBUF_FRESH 0x02      // latest buffer has data not discarded by SetReadDone
+#define PPBUF_READING 0x04    // reader holds a buffer
+#define PPBUF_READ_INDEX 0x08 // index of the held buffer
+
+#if (PING_PONG_BUFFER_USE_ATOMIC == 1)
+#define PPBUF_LOAD(ppbuf, order) atomic_load_explicit(&(ppbuf)->state, memory_order_##order)
+/* release publishes the writes to / reads from the buffer handed over, acquire sees the other side's */
+#define PPBUF_CAS(ppbuf, expected, desired)                                        \
+    atomic_compare_exchange_weak_explicit(&(ppbuf)->state, &(expected), (desired), \
+                                          memory_order_acq_rel, memory_order_acquire)
+#else
+#define PPBUF_LOAD(ppbuf, order) ((ppbuf)->state)
+#define PPBUF_CAS(ppbuf, expected, desired) ((ppbuf)->state = (desired), true)
+#endif
+
 /**
   * @brief  Ping-pong buffer initialization
   * @param  ppbuf: Pointer to the ping-pong buffer structure
@@ -38,61 +57,110 @@ void PingPongBuffer_Init(PingPongBuffer_t* ppbuf, void* buf0, void* buf1)
 }
 
 /**
-  * @brief  Get a readable buffer
+  * @brief  Get a readable buffer, reader side. The latest written buffer is held
+  *         until SetReadDone or the next GetReadBuf
   * @param  ppbuf:     Pointer to the ping-pong buffer structure
   * @param  pReadBuf:  Pointer to the pointer to the buffer to be read
   * @retval Returns true if there is a buffer to be read
   */
 bool PingPongBuffer_GetReadBuf(PingPongBuffer_t* ppbuf, void** pReadBuf)
 {
-    if(ppbuf->readAvaliable[0])
+    uint8_t state = PPBUF_LOAD(ppbuf, relaxed);
+    uint8_t next;
+    do
     {
-        ppbuf->readIndex = 0;
-    }
-    else if(ppbuf->readAvaliable[1])
-    {
-        ppbuf->readIndex = 1;
-    }
-    else
+        if(state & PPBUF_FRESH)
+        {
+            next = (state & ~PPBUF_READ_INDEX) | PPBUF_READING;
+            if(state & PPBUF_LATEST)
+            {
+                next |= PPBUF_READ_INDEX;
+            }
+        }
+        else
+        {
+            next = state & ~PPBUF_READING;
+        }
+    } while(!PPBUF_CAS(ppbuf, state, next));
+
+    if(!(next & PPBUF_READING))
     {
         return false;
     }
+    ppbuf->readIndex = (next & PPBUF_READ_INDEX) ? 1 : 0;
     *pReadBuf = ppbuf->buffer[ppbuf->readIndex];
     return true;
 }
 
 /**
-  * @brief  Notify buffer read completion
+  * @brief  Notify buffer read completion, the data read is discarded
   * @param  ppbuf: Pointer to the ping-pong buffer structure
   * @retval None
   */
 void PingPongBuffer_SetReadDone(PingPongBuffer_t* ppbuf)
 {
-    ppbuf->readAvaliable[ppbuf->readIndex] = false;
+    uint8_t state = PPBUF_LOAD(ppbuf, relaxed);
+    uint8_t next;
+    do
+    {
+        next = state & ~PPBUF_READING;
+        /* A newer buffer written meanwhile stays fresh */
+        if((state & PPBUF_READING) && !(state & PPBUF_READ_INDEX) == !(state & PPBUF_LATEST))
+        {
+            next &= ~PPBUF_FRESH;
+        }
+    } while(!PPBUF_CAS(ppbuf, state, next));
 }
 
 /**
-  * @brief  Get writable buffer
+  * @brief  Get writable buffer, writer side. Never the buffer held by the reader,
+  *         the latest one is only rewritten while the reader holds the other
   * @param  ppbuf:      Pointer to the ping-pong buffer structure
   * @param  pWriteBuf:  Pointer to the pointer to the buffer to be wriye
   * @retval None
   */
 void PingPongBuffer_GetWriteBuf(PingPongBuffer_t* ppbuf, void** pWriteBuf)
 {
-    if(ppbuf->writeIndex == ppbuf->readIndex)
+    /* acquire: the reads of a buffer released by the reader are done */
+    uint8_t state = PPBUF_LOAD(ppbuf, acquire);
+    uint8_t index;
+    for(;;)
     {
-        ppbuf->writeIndex = !ppbuf->readIndex;
+        if(state & PPBUF_READING)
+        {
+            index = (state & PPBUF_READ_INDEX) ? 0 : 1;
+        }
+        else
+        {
+            index = (state & PPBUF_LATEST) ? 0 : 1;
+        }
+        /* The reader only takes the latest buffer, any other one is ours without a CAS */
+        if(index != (state & PPBUF_LATEST))
+        {
+            break;
+        }
+        /* Old data is being overwritten, must not be read half done */
+        if(PPBUF_CAS(ppbuf, state, state & ~PPBUF_FRESH))
+        {
+            break;
+        }
     }
-    *pWriteBuf = ppbuf->buffer[ppbuf->writeIndex];
+
+    ppbuf->writeIndex = index;
+    *pWriteBuf = ppbuf->buffer[index];
 }
 
 /**
-  * @brief  Notify buffer write completion
+  * @brief  Notify buffer write completion, the buffer becomes the latest
   * @param  ppbuf: Pointer to the ping-pong buffer structure
   * @retval None
   */
 void PingPongBuffer_SetWriteDone(PingPongBuffer_t* ppbuf)
 {
-    ppbuf->readAvaliable[ppbuf->writeIndex] = true;
-    ppbuf->writeIndex = !ppbuf->writeIndex;
+    uint8_t state = PPBUF_LOAD(ppbuf, relaxed);
+    uint8_t next;
+    do
+    {
+        next = (state & ~PPBUF_LATEST) | PPBUF_FRESH | ppbuf->writeIndex;
+    } while(!PPBUF_CAS(ppbuf, state, next));
 }
@@ -30,12 +30,29 @@ extern "C" {
 #include <stdint.h>
 #include <stdbool.h>
 
+/* One writer and one reader on separate threads / cores, lock free with C11 atomics.
+ * Without them the state is a volatile byte: only safe for a single core. */
+#ifndef PING_PONG_BUFFER_USE_ATOMIC
+#if defined(__STDC_VERSION__) && (__STDC_VERSION__ >= 201112L) && !defined(__STDC_NO_ATOMICS__)
+#define PING_PONG_BUFFER_USE_ATOMIC 1
+#else
+#define PING_PONG_BUFFER_USE_ATOMIC 0
+#endif
+#endif
+
+#if (PING_PONG_BUFFER_USE_ATOMIC == 1) && !defined(__cplusplus)
+#include <stdatomic.h>
+typedef _Atomic uint8_t PingPongState_t;
+#else
+typedef volatile uint8_t PingPongState_t; // same layout, only PingPongBuffer.c touches it
+#endif
+
 typedef struct
 {
     void* buffer[2];
-    volatile uint8_t writeIndex;
-    volatile uint8_t readIndex;
-    volatile uint8_t readAvaliable[2];
+    uint8_t writeIndex;    // writer side only
+    uint8_t readIndex;     // reader side only
+    PingPongState_t state; // latest buffer, fresh, reading and read index bits
 } PingPongBuffer_t;
 
 void PingPongBuffer_Init(PingPongBuffer_t* ppbuf, void* buf0, void* buf1);
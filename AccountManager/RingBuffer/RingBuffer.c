@@ -0,0 +1,213 @@
+/*
+ * \file   RingBuffer.c
+ * \brief  N slot buffer between one writer and one reader
+ *
+ * - Description: Latest mode keeps the slot states in one word changed by CAS, like
+ *   PingPongBuffer. Queue mode is a single producer / single consumer ring on two counters,
+ *   each side steps its own slot index.
+ *
+ * - Created on: Oct 17, 2026
+ * - Author: StrugglingBunny
+ */
+#include "RingBuffer.h"
+#include <string.h>
+
+/* Latest mode state bits */
+#define RING_LATEST_MASK 0x000000FFu // last written slot
+#define RING_HELD_SHIFT 8
+#define RING_HELD_MASK 0x0000FF00u   // slot held by the reader + 1, 0 : none
+#define RING_FRESH 0x00010000u       // latest slot has data not discarded by SetReadDone
+
+#define RING_LATEST(state) ((state) & RING_LATEST_MASK)
+#define RING_HELD(state) (((state) & RING_HELD_MASK) >> RING_HELD_SHIFT)
+
+#if (RING_BUFFER_USE_ATOMIC == 1)
+#define RING_LOAD(var, order) atomic_load_explicit(&(var), memory_order_##order)
+#define RING_STORE(var, value) atomic_store_explicit(&(var), (value), memory_order_release)
+/* release publishes the writes to / reads from the slot handed over, acquire sees the other side's */
+#define RING_CAS(var, expected, desired)                                \
+    atomic_compare_exchange_weak_explicit(&(var), &(expected), (desired), \
+                                          memory_order_acq_rel, memory_order_acquire)
+#else
+#define RING_LOAD(var, order) (var)
+#define RING_STORE(var, value) ((var) = (value))
+#define RING_CAS(var, expected, desired) ((var) = (desired), true)
+#endif
+
+/**
+  * @brief  Ring buffer initialization
+  * @param  rb:       Pointer to the ring buffer structure
+  * @param  buf:      depth * slotSize bytes
+  * @param  slotSize: Bytes between two slots
+  * @param  depth:    Number of slots, 2 ~ RING_BUFFER_DEPTH_MAX for the latest mode, 1 ~ for the queue
+  * @param  mode:     RING_BUFFER_LATEST or RING_BUFFER_QUEUE
+  * @retval None
+  */
+void RingBuffer_Init(RingBuffer_t* rb, void* buf, uint32_t slotSize, uint8_t depth, RingBufferMode_t mode)
+{
+    memset(rb, 0, sizeof(RingBuffer_t));
+    rb->buffer = (uint8_t*)buf;
+    rb->slotSize = slotSize;
+    rb->depth = depth;
+    rb->mode = (uint8_t)mode;
+}
+
+/**
+  * @brief  Get a readable buffer, reader side. Latest mode: the newest frame, queue mode: the oldest.
+  *         The slot is held until SetReadDone, getting it again without SetReadDone reads it again
+  * @param  rb:        Pointer to the ring buffer structure
+  * @param  pReadBuf:  Pointer to the pointer to the buffer to be read
+  * @retval Returns true if there is a buffer to be read
+  */
+bool RingBuffer_GetReadBuf(RingBuffer_t* rb, void** pReadBuf)
+{
+    if(rb->mode == RING_BUFFER_QUEUE)
+    {
+        uint32_t tail = RING_LOAD(rb->tail, relaxed);
+        if(tail == RING_LOAD(rb->head, acquire))
+        {
+            rb->reading = false;
+            return false;
+        }
+    }
+    else
+    {
+        uint32_t state = RING_LOAD(rb->state, relaxed);
+        uint32_t next;
+        do
+        {
+            next = state & ~RING_HELD_MASK;
+            if(state & RING_FRESH)
+            {
+                next |= (RING_LATEST(state) + 1) << RING_HELD_SHIFT;
+            }
+        } while(!RING_CAS(rb->state, state, next));
+
+        if(!(next & RING_HELD_MASK))
+        {
+            rb->reading = false;
+            return false;
+        }
+        rb->readIndex = (uint8_t)RING_LATEST(next);
+    }
+    rb->reading = true;
+    *pReadBuf = rb->buffer + (uint32_t)rb->readIndex * rb->slotSize;
+    return true;
+}
+
+/**
+  * @brief  Notify buffer read completion, the frame read is discarded
+  * @param  rb: Pointer to the ring buffer structure
+  * @retval None
+  */
+void RingBuffer_SetReadDone(RingBuffer_t* rb)
+{
+    if(!rb->reading)
+    {
+        return;
+    }
+    rb->reading = false;
+    if(rb->mode == RING_BUFFER_QUEUE)
+    {
+        rb->readIndex = (rb->readIndex + 1 == rb->depth) ? 0 : rb->readIndex + 1;
+        RING_STORE(rb->tail, RING_LOAD(rb->tail, relaxed) + 1);
+        return;
+    }
+    uint32_t state = RING_LOAD(rb->state, relaxed);
+    uint32_t next;
+    do
+    {
+        next = state & ~RING_HELD_MASK;
+        /* A newer frame written meanwhile stays fresh */
+        if(RING_HELD(state) == RING_LATEST(state) + 1)
+        {
+            next &= ~RING_FRESH;
+        }
+    } while(!RING_CAS(rb->state, state, next));
+}
+
+/**
+  * @brief  Get writable buffer, writer side. Latest mode: a slot that is neither held by the reader
+  *         nor the newest, only with 2 slots the newest one is rewritten while the reader holds the other
+  * @param  rb:         Pointer to the ring buffer structure
+  * @param  pWriteBuf:  Pointer to the pointer to the buffer to be write
+  * @retval Returns false if the queue is full, the frame is counted as dropped
+  */
+bool RingBuffer_GetWriteBuf(RingBuffer_t* rb, void** pWriteBuf)
+{
+    if(rb->mode == RING_BUFFER_QUEUE)
+    {
+        /* The counters only give the fill level, the difference stays right across the 2^32 wrap */
+        if(RING_LOAD(rb->head, relaxed) - RING_LOAD(rb->tail, acquire) >= rb->depth)
+        {
+            rb->dropped++;
+            return false;
+        }
+    }
+    else
+    {
+        /* acquire: the reads of a slot released by the reader are done */
+        uint32_t state = RING_LOAD(rb->state, acquire);
+        uint8_t index;
+        for(;;)
+        {
+            uint32_t latest = RING_LATEST(state);
+            uint32_t held = RING_HELD(state);
+            index = rb->writeIndex;
+            for(uint8_t i = 0; i < rb->depth; i++)
+            {
+                index = (index + 1 == rb->depth) ? 0 : index + 1;
+                if(index != latest && index + 1u != held)
+                {
+                    break;
+                }
+            }
+            /* The reader only moves to the latest slot, any other free one is ours without a CAS */
+            if(index != latest && index + 1u != held)
+            {
+                break;
+            }
+            /* 2 slots, the reader holds the other one: rewrite the newest */
+            index = (held == 1) ? 1 : 0;
+            if(RING_CAS(rb->state, state, state & ~RING_FRESH))
+            {
+                if(state & RING_FRESH)
+                {
+                    rb->dropped++;
+                }
+                break;
+            }
+        }
+        rb->writeIndex = index;
+    }
+    *pWriteBuf = rb->buffer + (uint32_t)rb->writeIndex * rb->slotSize;
+    return true;
+}
+
+/**
+  * @brief  Notify buffer write completion. Latest mode: the buffer becomes the newest frame,
+  *         queue mode: it is appended
+  * @param  rb: Pointer to the ring buffer structure
+  * @retval None
+  */
+void RingBuffer_SetWriteDone(RingBuffer_t* rb)
+{
+    if(rb->mode == RING_BUFFER_QUEUE)
+    {
+        rb->writeIndex = (rb->writeIndex + 1 == rb->depth) ? 0 : rb->writeIndex + 1;
+        RING_STORE(rb->head, RING_LOAD(rb->head, relaxed) + 1);
+        return;
+    }
+    uint32_t state = RING_LOAD(rb->state, relaxed);
+    uint32_t next;
+    do
+    {
+        next = (state & ~(RING_LATEST_MASK | RING_FRESH)) | rb->writeIndex | RING_FRESH;
+    } while(!RING_CAS(rb->state, state, next));
+
+    /* The previous frame was never read */
+    if((state & RING_FRESH) && RING_HELD(state) != RING_LATEST(state) + 1)
+    {
+        rb->dropped++;
+    }
+}
@@ -0,0 +1,73 @@
+/*
+ * \file   RingBuffer.h
+ * \brief  N slot buffer between one writer and one reader
+ *
+ * - Description: Generalized PingPongBuffer with the same Get / Done calls.
+ *   RING_BUFFER_LATEST: the reader gets the newest frame, with 3 or more slots
+ *   the writer never waits for the reader nor overwrites the newest frame (triple buffering).
+ *   RING_BUFFER_QUEUE: every frame is kept in order, GetWriteBuf fails when the N slots are full.
+ *
+ * - Created on: Oct 17, 2026
+ * - Author: StrugglingBunny
+ */
+#ifndef __RING_BUFFER_H
+#define __RING_BUFFER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* One writer and one reader on separate threads / cores, lock free with C11 atomics.
+ * Without them the state is volatile: only safe for a single core. */
+#ifndef RING_BUFFER_USE_ATOMIC
+#if defined(__STDC_VERSION__) && (__STDC_VERSION__ >= 201112L) && !defined(__STDC_NO_ATOMICS__)
+#define RING_BUFFER_USE_ATOMIC 1
+#else
+#define RING_BUFFER_USE_ATOMIC 0
+#endif
+#endif
+
+#if (RING_BUFFER_USE_ATOMIC == 1) && !defined(__cplusplus)
+#include <stdatomic.h>
+typedef _Atomic uint32_t RingState_t;
+#else
+typedef volatile uint32_t RingState_t; // same layout, only RingBuffer.c touches it
+#endif
+
+#define RING_BUFFER_DEPTH_MAX 255
+
+typedef enum
+{
+    RING_BUFFER_LATEST, // newest frame only, older unread frames are dropped, depth >= 2
+    RING_BUFFER_QUEUE   // every frame in order, a frame is dropped when the queue is full, depth >= 1
+} RingBufferMode_t;
+
+typedef struct
+{
+    uint8_t* buffer;    // depth slots of slotSize bytes
+    uint32_t slotSize;
+    uint8_t depth;
+    uint8_t mode;
+    uint8_t writeIndex; // writer side only, queue: next slot to write
+    uint8_t readIndex;  // reader side only, queue: next slot to read
+    uint8_t reading;    // reader side only, a slot is held
+    uint32_t dropped;   // writer side only, frames overwritten unread or refused by a full queue
+    RingState_t state;  // latest: latest slot, held slot + 1 and fresh bits
+    RingState_t head;   // queue: frames written
+    RingState_t tail;   // queue: frames read
+} RingBuffer_t;
+
+void RingBuffer_Init(RingBuffer_t* rb, void* buf, uint32_t slotSize, uint8_t depth, RingBufferMode_t mode);
+bool RingBuffer_GetReadBuf(RingBuffer_t* rb, void** pReadBuf);
+void RingBuffer_SetReadDone(RingBuffer_t* rb);
+bool RingBuffer_GetWriteBuf(RingBuffer_t* rb, void** pWriteBuf);
+void RingBuffer_SetWriteDone(RingBuffer_t* rb);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
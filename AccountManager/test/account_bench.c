@@ -0,0 +1,247 @@
+/*
+ * \file   account_bench.c
+ * \brief  AccountManager benchmarks
+ *
+ * - Build (hosted):
+ *     gcc -O2 -DDATA_CENTER_USE_LOG=0 -I.. -I../PingPongBuffer -I../RingBuffer -I../../HeapManager \
+ *         account_bench.c ../Account.c ../PingPongBuffer/PingPongBuffer.c ../RingBuffer/RingBuffer.c \
+ *         ../../HeapManager/HeapManager.c -o account_bench
+ *   Build with -DHEAP_MANAGER_USE_ZERO_TRACK=0 to get the startup cost without known-zero blocks.
+ */
+#include "HeapManager.h"
+#include "Account.h"
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#define BENCH_HEAP_SIZE (4 * 1024 * 1024)
+#define BENCH_ACCOUNT_NUM 1000
+#define BENCH_ACCOUNT_BUF_SIZE 1024
+#define BENCH_ROUNDS 20
+#define BENCH_ID_NUM 2000 // most accounts of any bench
+#define BENCH_PUBLISH_OPS 20000
+#define BENCH_FRAME_SIZE (8 * 1024) // sensor frame
+#define BENCH_FRAME_OPS 20000
+#define BENCH_BURST_CYCLES 1000
+#define BENCH_BURST_LEN 12    // messages committed at the start of a cycle
+#define BENCH_BURST_PERIOD 16 // steps per cycle, the subscriber pulls once per step
+
+static uint8_t heap_buffer[BENCH_HEAP_SIZE];
+static uint32_t frame_src[BENCH_FRAME_SIZE / 4], frame_dst[BENCH_FRAME_SIZE / 4];
+static char account_ids[BENCH_ID_NUM][16]; // the manager keeps the ID pointers
+
+static uint64_t bench_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+/**
+ * @brief  Startup: create BENCH_ACCOUNT_NUM accounts with a ping-pong buffer each
+ *         on a fresh heap, best of BENCH_ROUNDS
+ * @param  zeroed: the heap buffer is known to be zero (heap_mgr_initZeroed)
+ * @retval void
+ */
+static void bench_account_startup(bool zeroed)
+{
+    uint64_t best = UINT64_MAX;
+    for (int round = 0; round < BENCH_ROUNDS; round++)
+    {
+        memset(heap_buffer, 0, sizeof(heap_buffer)); // not timed, a .bss buffer is zero at boot
+#if (HEAP_MANAGER_USE_ZERO_TRACK == 1)
+        if (zeroed)
+        {
+            heap_mgr_initZeroed(heap_buffer, sizeof(heap_buffer), NULL, NULL);
+        }
+        else
+#endif
+        {
+            heap_mgr_init(heap_buffer, sizeof(heap_buffer), NULL, NULL);
+        }
+        uint64_t start = bench_now_ns();
+        AccountManager_Init();
+        for (int i = 0; i < BENCH_ACCOUNT_NUM; i++)
+        {
+            if (!AccountManager_CreateAccount(account_ids[i], BENCH_ACCOUNT_BUF_SIZE, NULL))
+            {
+                printf("account startup: create %s failed\n", account_ids[i]);
+                return;
+            }
+        }
+        uint64_t ns = bench_now_ns() - start;
+        best = ns < best ? ns : best;
+    }
+    printf("account startup (%d accounts x %d x2 bytes, zero track=%d, zeroed heap=%d): %.1f us\n",
+           BENCH_ACCOUNT_NUM, BENCH_ACCOUNT_BUF_SIZE, HEAP_MANAGER_USE_ZERO_TRACK, zeroed, best / 1000.0);
+}
+
+static int bench_sub_cb(Account *account, EventParam_t *param)
+{
+    (void)account;
+    (void)param;
+    return RES_OK;
+}
+/**
+ * @brief  Publish latency against the account count: commit + publish of the last created account
+ *         to one subscriber, among accountNum accounts
+ * @param  accountNum
+ * @retval void
+ */
+static void bench_publish_latency(int accountNum)
+{
+    heap_mgr_init(heap_buffer, sizeof(heap_buffer), NULL, NULL);
+    AccountManager_Init();
+    for (int i = 0; i < accountNum; i++)
+    {
+        if (!AccountManager_CreateAccount(account_ids[i], sizeof(uint32_t), NULL))
+        {
+            printf("publish latency: create %s failed\n", account_ids[i]);
+            return;
+        }
+    }
+    const char *pub = account_ids[accountNum - 1];
+    Account_registerCb(account_ids[0], bench_sub_cb);
+    Account_subscribe(account_ids[0], pub);
+    uint64_t start = bench_now_ns();
+    for (uint32_t i = 0; i < BENCH_PUBLISH_OPS; i++)
+    {
+        Account_commit(pub, &i, sizeof(i));
+        Account_publish(pub);
+    }
+    uint64_t ns = bench_now_ns() - start;
+    AccountHandle pubHandle = AccountManager_getHandle(pub);
+    start = bench_now_ns();
+    for (uint32_t i = 0; i < BENCH_PUBLISH_OPS; i++)
+    {
+        Account_commitH(pubHandle, &i, sizeof(i));
+        Account_publishH(pubHandle);
+    }
+    uint64_t nsHandle = bench_now_ns() - start;
+    printf("publish latency (%d accounts): %.1f ns per commit + publish by ID, %.1f ns by handle\n",
+           accountNum, (double)ns / BENCH_PUBLISH_OPS, (double)nsHandle / BENCH_PUBLISH_OPS);
+    AccountManager_DeInit();
+}
+/**
+ * @brief  Frame transfer: producer fills an 8 KB frame, the subscriber sums it.
+ *         Copy path: commit + pull (two memcpy), loan path: beginCommit/endCommit + pullLoan/pullRelease
+ * @retval void
+ */
+static void bench_frame_transfer(void)
+{
+    heap_mgr_init(heap_buffer, sizeof(heap_buffer), NULL, NULL);
+    AccountManager_Init();
+    AccountHandle pub = AccountManager_CreateAccount("frame_pub", BENCH_FRAME_SIZE, NULL);
+    AccountHandle sub = AccountManager_CreateAccount("frame_sub", 0, NULL);
+    Account_subscribe("frame_sub", "frame_pub");
+    uint32_t sum = 0;
+    uint64_t start = bench_now_ns();
+    for (uint32_t i = 0; i < BENCH_FRAME_OPS; i++)
+    {
+        for (uint32_t j = 0; j < BENCH_FRAME_SIZE / 4; j++)
+        {
+            frame_src[j] = i + j;
+        }
+        Account_commitH(pub, frame_src, BENCH_FRAME_SIZE);
+        Account_pullH(sub, pub, frame_dst, BENCH_FRAME_SIZE);
+        for (uint32_t j = 0; j < BENCH_FRAME_SIZE / 4; j++)
+        {
+            sum += frame_dst[j];
+        }
+    }
+    uint64_t nsCopy = bench_now_ns() - start;
+    uint32_t sumCopy = sum;
+    sum = 0;
+    start = bench_now_ns();
+    for (uint32_t i = 0; i < BENCH_FRAME_OPS; i++)
+    {
+        void *wBuf;
+        Account_beginCommitH(pub, &wBuf);
+        uint32_t *frame = (uint32_t *)wBuf;
+        for (uint32_t j = 0; j < BENCH_FRAME_SIZE / 4; j++)
+        {
+            frame[j] = i + j;
+        }
+        Account_endCommitH(pub);
+        const void *rBuf;
+        if (Account_pullLoanH(sub, pub, &rBuf, BENCH_FRAME_SIZE) == RES_OK)
+        {
+            const uint32_t *data = (const uint32_t *)rBuf;
+            for (uint32_t j = 0; j < BENCH_FRAME_SIZE / 4; j++)
+            {
+                sum += data[j];
+            }
+            Account_pullReleaseH(sub, pub);
+        }
+    }
+    uint64_t nsLoan = bench_now_ns() - start;
+    printf("frame transfer (%d bytes): %.2f us copy, %.2f us loan%s\n",
+           BENCH_FRAME_SIZE, nsCopy / 1000.0 / BENCH_FRAME_OPS, nsLoan / 1000.0 / BENCH_FRAME_OPS,
+           sum == sumCopy ? "" : " (data mismatch!)");
+    AccountManager_DeInit();
+}
+/**
+ * @brief  Bursty publisher: BENCH_BURST_LEN commits at the start of every cycle, the subscriber
+ *         pulls once per step, BENCH_BURST_PERIOD steps per cycle. Drop rate = commits never pulled
+ * @param  depth
+ * @param  mode
+ * @retval void
+ */
+static void bench_burst_drop(uint8_t depth, RingBufferMode_t mode)
+{
+    heap_mgr_init(heap_buffer, sizeof(heap_buffer), NULL, NULL);
+    AccountManager_Init();
+    AccountHandle pub = AccountManager_CreateAccountEx("burst_pub", sizeof(uint32_t), depth, mode, NULL);
+    AccountHandle sub = AccountManager_CreateAccount("burst_sub", 0, NULL);
+    Account_subscribe("burst_sub", "burst_pub");
+    uint32_t seq = 0, pulled = 0, last = 0, outOfOrder = 0;
+    uint64_t start = bench_now_ns();
+    for (int cycle = 0; cycle < BENCH_BURST_CYCLES; cycle++)
+    {
+        for (int i = 0; i < BENCH_BURST_LEN; i++)
+        {
+            seq++;
+            Account_commitH(pub, &seq, sizeof(seq));
+        }
+        for (int step = 0; step < BENCH_BURST_PERIOD; step++)
+        {
+            uint32_t value;
+            if (Account_pullH(sub, pub, &value, sizeof(value)) == RES_OK)
+            {
+                outOfOrder += value <= last;
+                last = value;
+                pulled++;
+            }
+        }
+    }
+    uint64_t ns = bench_now_ns() - start;
+    printf("burst %-6s depth %2d: %5.1f %% dropped, %.1f ns per message%s\n",
+           mode == RING_BUFFER_QUEUE ? "queue" : "latest", depth, 100.0 * (seq - pulled) / seq,
+           (double)ns / seq, outOfOrder ? " (out of order!)" : "");
+    AccountManager_DeInit();
+}
+
+int main(void)
+{
+    for (int i = 0; i < BENCH_ID_NUM; i++)
+    {
+        snprintf(account_ids[i], sizeof(account_ids[i]), "acc%d", i);
+    }
+    bench_account_startup(false);
+    bench_account_startup(true);
+    bench_publish_latency(10);
+    bench_publish_latency(100);
+    bench_publish_latency(500);
+    bench_publish_latency(1000);
+    bench_publish_latency(2000);
+    bench_frame_transfer();
+    static const uint8_t depths[] = {2, 3, 4, 8, 16};
+    for (uint32_t i = 0; i < sizeof(depths) / sizeof(depths[0]); i++)
+    {
+        bench_burst_drop(depths[i], RING_BUFFER_LATEST);
+    }
+    for (uint32_t i = 0; i < sizeof(depths) / sizeof(depths[0]); i++)
+    {
+        bench_burst_drop(depths[i], RING_BUFFER_QUEUE);
+    }
+    return 0;
+}
@@ -0,0 +1,178 @@
+/*
+ * \file   pingpong_bench.c
+ * \brief  PingPongBuffer two-thread torture test and throughput benchmark
+ *
+ * - Build (hosted):
+ *     gcc -O2 -pthread -I../PingPongBuffer pingpong_bench.c ../PingPongBuffer/PingPongBuffer.c -o pingpong_bench
+ *   Add -fsanitize=thread to check the memory ordering as well.
+ * - One writer thread fills every word of a frame with its sequence number, one reader
+ *   thread checks that a frame is never torn and that the sequence never goes back.
+ */
+#include "PingPongBuffer.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sched.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+
+#define BENCH_TORTURE_FRAMES 2000000
+#define BENCH_TORTURE_FRAMES_LARGE 100000 // 8 KB frames
+#define BENCH_THROUGHPUT_MS 1000
+#define BENCH_FRAME_WORDS_MAX (8 * 1024 / 4)
+#define BENCH_WRITER_YIELD 16 // frames between writer yields on a single core, else the reader rarely runs
+
+typedef struct
+{
+    PingPongBuffer_t ppbuf;
+    uint32_t frameWords;
+    uint32_t frames;      // writer stops after this many frames, 0 : at stop
+    atomic_int stop;      // throughput run only, set by the main thread
+    uint64_t written;
+    uint64_t read;
+    uint64_t torn;        // frame with mixed sequence numbers
+    uint64_t backwards;   // frame older than the previous one
+} BenchPair_t;
+
+static uint32_t frame_buffer[2][BENCH_FRAME_WORDS_MAX];
+static int bench_single_core;
+
+static uint64_t bench_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static void *bench_writer(void *arg)
+{
+    BenchPair_t *pair = (BenchPair_t *)arg;
+    uint32_t seq = 0;
+    while (pair->frames ? seq < pair->frames : !atomic_load_explicit(&pair->stop, memory_order_relaxed))
+    {
+        void *wBuf;
+        PingPongBuffer_GetWriteBuf(&pair->ppbuf, &wBuf);
+        uint32_t *frame = (uint32_t *)wBuf;
+        seq++;
+        for (uint32_t i = 0; i < pair->frameWords; i++)
+        {
+            frame[i] = seq;
+            if (bench_single_core && i == pair->frameWords / 2 && seq % BENCH_WRITER_YIELD == 0)
+            {
+                sched_yield(); // switch in the middle of the frame
+            }
+        }
+        PingPongBuffer_SetWriteDone(&pair->ppbuf);
+    }
+    pair->written = seq;
+    return NULL;
+}
+
+static void *bench_reader(void *arg)
+{
+    BenchPair_t *pair = (BenchPair_t *)arg;
+    uint32_t last = 0;
+    uint32_t idle = 0;
+    while (pair->frames ? last < pair->frames : !atomic_load_explicit(&pair->stop, memory_order_relaxed))
+    {
+        void *rBuf;
+        if (!PingPongBuffer_GetReadBuf(&pair->ppbuf, &rBuf))
+        {
+            if (++idle % 64 == 0)
+            {
+                sched_yield(); // let the writer run on a single core
+            }
+            continue;
+        }
+        const uint32_t *frame = (const uint32_t *)rBuf;
+        uint32_t seq = frame[0];
+        for (uint32_t i = 1; i < pair->frameWords; i++)
+        {
+            if (bench_single_core && i == pair->frameWords / 2 && pair->read % 2 == 0)
+            {
+                sched_yield();
+            }
+            if (frame[i] != seq)
+            {
+                pair->torn++;
+                break;
+            }
+        }
+        if (seq <= last)
+        {
+            pair->backwards++;
+        }
+        last = seq;
+        pair->read++;
+        PingPongBuffer_SetReadDone(&pair->ppbuf);
+    }
+    return NULL;
+}
+
+static void bench_pair_run(BenchPair_t *pair, uint32_t frameWords, uint32_t frames)
+{
+    pthread_t writer, reader;
+    PingPongBuffer_Init(&pair->ppbuf, frame_buffer[0], frame_buffer[1]);
+    pair->frameWords = frameWords;
+    pair->frames = frames;
+    atomic_store(&pair->stop, 0);
+    pair->written = pair->read = pair->torn = pair->backwards = 0;
+    pthread_create(&reader, NULL, bench_reader, pair);
+    pthread_create(&writer, NULL, bench_writer, pair);
+    if (!frames)
+    {
+        struct timespec ts = {BENCH_THROUGHPUT_MS / 1000, (BENCH_THROUGHPUT_MS % 1000) * 1000000L};
+        nanosleep(&ts, NULL);
+        atomic_store(&pair->stop, 1);
+    }
+    pthread_join(writer, NULL);
+    pthread_join(reader, NULL);
+}
+/**
+ * @brief  Torture: every frame the reader gets must be whole and newer
+ * @param  frameWords
+ * @param  frames
+ * @retval 0 if passed
+ */
+static int bench_torture(uint32_t frameWords, uint32_t frames)
+{
+    static BenchPair_t pair;
+    bench_pair_run(&pair, frameWords, frames);
+    int failed = pair.torn || pair.backwards;
+    printf("torture (%u bytes, atomic=%d): %llu written, %llu read, %llu torn, %llu out of order: %s\n",
+           (unsigned)(frameWords * 4), PING_PONG_BUFFER_USE_ATOMIC,
+           (unsigned long long)pair.written, (unsigned long long)pair.read,
+           (unsigned long long)pair.torn, (unsigned long long)pair.backwards, failed ? "FAILED" : "ok");
+    return failed;
+}
+/**
+ * @brief  Throughput: writer and reader flat out for BENCH_THROUGHPUT_MS
+ * @param  frameWords
+ * @retval void
+ */
+static void bench_throughput(uint32_t frameWords)
+{
+    static BenchPair_t pair;
+    uint64_t start = bench_now_ns();
+    bench_pair_run(&pair, frameWords, 0);
+    double s = (bench_now_ns() - start) / 1e9;
+    printf("throughput (%u bytes): %.2f M msg/s written, %.2f M msg/s read\n",
+           (unsigned)(frameWords * 4), pair.written / s / 1e6, pair.read / s / 1e6);
+}
+
+int main(void)
+{
+    int failed = 0;
+    bench_single_core = sysconf(_SC_NPROCESSORS_ONLN) <= 1;
+    if (bench_single_core)
+    {
+        printf("single core: writer and reader yield in the middle of a frame\n");
+    }
+    failed |= bench_torture(4, BENCH_TORTURE_FRAMES);
+    failed |= bench_torture(64, BENCH_TORTURE_FRAMES);
+    failed |= bench_torture(BENCH_FRAME_WORDS_MAX, BENCH_TORTURE_FRAMES_LARGE);
+    bench_throughput(4);
+    bench_throughput(64);
+    bench_throughput(BENCH_FRAME_WORDS_MAX);
+    return failed;
+}
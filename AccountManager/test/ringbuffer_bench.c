@@ -0,0 +1,196 @@
+/*
+ * \file   ringbuffer_bench.c
+ * \brief  RingBuffer two-thread torture test, throughput and drop rate against the depth
+ *
+ * - Build (hosted):
+ *     gcc -O2 -pthread -I../RingBuffer ringbuffer_bench.c ../RingBuffer/RingBuffer.c -o ringbuffer_bench
+ *   Add -fsanitize=thread to check the memory ordering as well.
+ * - The writer sends BENCH_BURST_LEN frames back to back, then pauses, the reader takes
+ *   one frame at a time. Every frame read must be whole and newer than the previous one,
+ *   and every frame not read must be counted as dropped.
+ * - The queue runs again with the counters started BENCH_WRAP_FRAMES before 2^32.
+ */
+#include "RingBuffer.h"
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+
+#define BENCH_FRAMES 200000
+#define BENCH_FRAME_WORDS 16 // 64 bytes
+#define BENCH_BURST_LEN 8
+#define BENCH_BURST_PAUSE_NS 20000
+#define BENCH_DEPTH_MAX 16
+#define BENCH_WRAP_FRAMES 1000 // frames queued before the counters wrap
+
+typedef struct
+{
+    RingBuffer_t rb;
+    atomic_int done;     // writer finished
+    uint64_t read;
+    uint64_t torn;       // frame with mixed sequence numbers
+    uint64_t backwards;  // frame not newer than the previous one
+    uint64_t gaps;       // frames neither read nor counted as dropped
+    uint64_t refused;    // writer side: GetWriteBuf failed (queue full)
+} BenchRing_t;
+
+static uint32_t slot_buffer[BENCH_DEPTH_MAX][BENCH_FRAME_WORDS];
+static int bench_single_core;
+
+static uint64_t bench_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static void bench_pause(uint64_t ns)
+{
+    if (bench_single_core)
+    {
+        sched_yield(); // give the reader the core for the pause
+        return;
+    }
+    uint64_t end = bench_now_ns() + ns;
+    while (bench_now_ns() < end)
+    {
+    }
+}
+
+static void *bench_writer(void *arg)
+{
+    BenchRing_t *ring = (BenchRing_t *)arg;
+    for (uint32_t seq = 1; seq <= BENCH_FRAMES; seq++)
+    {
+        void *wBuf;
+        if (RingBuffer_GetWriteBuf(&ring->rb, &wBuf))
+        {
+            uint32_t *frame = (uint32_t *)wBuf;
+            for (uint32_t i = 0; i < BENCH_FRAME_WORDS; i++)
+            {
+                frame[i] = seq;
+                if (bench_single_core && i == BENCH_FRAME_WORDS / 2 && seq % 64 == 0)
+                {
+                    sched_yield(); // switch in the middle of the frame
+                }
+            }
+            RingBuffer_SetWriteDone(&ring->rb);
+        }
+        else
+        {
+            ring->refused++;
+        }
+        if (seq % BENCH_BURST_LEN == 0)
+        {
+            bench_pause(BENCH_BURST_PAUSE_NS);
+        }
+    }
+    atomic_store(&ring->done, 1);
+    return NULL;
+}
+
+static void *bench_reader(void *arg)
+{
+    BenchRing_t *ring = (BenchRing_t *)arg;
+    uint32_t last = 0;
+    for (;;)
+    {
+        /* Read done before the final check, the writer may finish in between */
+        int done = atomic_load(&ring->done);
+        void *rBuf;
+        if (!RingBuffer_GetReadBuf(&ring->rb, &rBuf))
+        {
+            if (done)
+            {
+                break;
+            }
+            if (bench_single_core)
+            {
+                sched_yield();
+            }
+            continue;
+        }
+        const uint32_t *frame = (const uint32_t *)rBuf;
+        uint32_t seq = frame[0];
+        for (uint32_t i = 1; i < BENCH_FRAME_WORDS; i++)
+        {
+            if (bench_single_core && i == BENCH_FRAME_WORDS / 2 && ring->read % 2 == 0)
+            {
+                sched_yield();
+            }
+            if (frame[i] != seq)
+            {
+                ring->torn++;
+                break;
+            }
+        }
+        if (seq <= last)
+        {
+            ring->backwards++;
+        }
+        last = seq;
+        ring->read++;
+        RingBuffer_SetReadDone(&ring->rb);
+    }
+    return NULL;
+}
+/**
+ * @brief  Run BENCH_FRAMES bursty frames through one ring
+ * @param  depth
+ * @param  mode
+ * @param  counter: initial queue counters
+ * @retval 0 if passed
+ */
+static int bench_ring(uint8_t depth, RingBufferMode_t mode, uint32_t counter)
+{
+    static BenchRing_t ring;
+    pthread_t writer, reader;
+    RingBuffer_Init(&ring.rb, slot_buffer, sizeof(slot_buffer[0]), depth, mode);
+    ring.rb.head = counter;
+    ring.rb.tail = counter;
+    atomic_store(&ring.done, 0);
+    ring.read = ring.torn = ring.backwards = ring.gaps = ring.refused = 0;
+    uint64_t start = bench_now_ns();
+    pthread_create(&reader, NULL, bench_reader, &ring);
+    pthread_create(&writer, NULL, bench_writer, &ring);
+    pthread_join(writer, NULL);
+    pthread_join(reader, NULL);
+    double s = (bench_now_ns() - start) / 1e9;
+    /* Every frame is read or counted in dropped: refused by the full queue or overwritten unread */
+    ring.gaps = BENCH_FRAMES - ring.rb.dropped - ring.read;
+    int failed = ring.torn || ring.backwards || ring.gaps;
+    if (mode == RING_BUFFER_QUEUE)
+    {
+        failed |= ring.refused != ring.rb.dropped;
+    }
+    printf("%-6s depth %2d%s: %5.1f %% dropped, %.2f M msg/s read, %llu torn, %llu out of order, %llu lost: %s\n",
+           mode == RING_BUFFER_QUEUE ? "queue" : "latest", depth, counter ? " wrap" : "",
+           100.0 * (BENCH_FRAMES - ring.read) / BENCH_FRAMES, ring.read / s / 1e6,
+           (unsigned long long)ring.torn, (unsigned long long)ring.backwards,
+           (unsigned long long)ring.gaps, failed ? "FAILED" : "ok");
+    return failed;
+}
+
+int main(void)
+{
+    static const uint8_t depths[] = {2, 3, 4, 8, BENCH_DEPTH_MAX};
+    int failed = 0;
+    bench_single_core = sysconf(_SC_NPROCESSORS_ONLN) <= 1;
+    printf("%d frames of %d bytes in bursts of %d, atomic=%d%s\n", BENCH_FRAMES, BENCH_FRAME_WORDS * 4,
+           BENCH_BURST_LEN, RING_BUFFER_USE_ATOMIC, bench_single_core ? ", single core: yields in the middle of a frame" : "");
+    for (uint32_t i = 0; i < sizeof(depths) / sizeof(depths[0]); i++)
+    {
+        failed |= bench_ring(depths[i], RING_BUFFER_LATEST, 0);
+    }
+    for (uint32_t i = 0; i < sizeof(depths) / sizeof(depths[0]); i++)
+    {
+        failed |= bench_ring(depths[i], RING_BUFFER_QUEUE, 0);
+    }
+    for (uint32_t i = 0; i < sizeof(depths) / sizeof(depths[0]); i++)
+    {
+        failed |= bench_ring(depths[i], RING_BUFFER_QUEUE, UINT32_MAX - BENCH_WRAP_FRAMES);
+    }
+    return failed;
+}
@@ -14,125 +14,611 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include <string.h>
-static void __enter_critical();
-static void __exit_critical();
-static void *__internal_malloc(uint32_t size);
-static void __internal_free(void *ptr);
+#if (HEAP_MANAGER_USE_MMAP == 1)
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+#if (HEAP_MANAGER_USE_PROFILE == 1)
+#include <stdio.h> // heap_mgr_dump_profile writes with printf even without HEAP_MANAGER_USE_LOG
+#endif
+
+#if (HEAP_MANAGER_USE_PROFILE == 1)
+// The allocation site macros are for the callers, the definitions below use the plain names
+#undef heap_mgr_malloc
+#undef heap_mgr_calloc
+#undef heap_mgr_realloc
+#undef heap_mgr_aligned_alloc
+#undef heap_mgr_aligned_calloc
+#endif
+
+#if (HEAP_MANAGER_BLOCK_LAYOUT == HEAP_BLOCK_LAYOUT_BOUNDARY_TAG)
+#define HEAP_FOOTER_SIZE sizeof(uint32_t)
+#else
+#define HEAP_FOOTER_SIZE 0
+#endif
+#if (HEAP_MANAGER_USE_TLSF == 1)
+#define HEAP_MIN_FREE_SIZE (sizeof(HeapFreeLink) + HEAP_FOOTER_SIZE) // a free block must hold its list links
+#else
+#define HEAP_MIN_FREE_SIZE (HEAP_FOOTER_SIZE > 0 ? HEAP_FOOTER_SIZE : 1)
+#endif
+#if (HEAP_MANAGER_USE_TLSF == 1)
+#define HEAP_FREE_META_HEAD sizeof(HeapFreeLink) // bytes at the start of a free payload used by the free index
+#else
+#define HEAP_FREE_META_HEAD 0
+#endif
+#define HEAP_MIN_BLOCK_SIZE ((HEAP_MIN_FREE_SIZE + sizeof(void *) - 1) & ~(sizeof(void *) - 1))
+#if (HEAP_MANAGER_USE_BLOCK_CHECK == 1)
+/* The block address is mixed in, a header copied from elsewhere or left in the payload does not match */
+#define HEAP_BLOCK_MAGIC_USED 0xA110C8EDu
+#define HEAP_BLOCK_MAGIC_FREE 0xF4EEB10Cu
+#define HEAP_BLOCK_MAGIC_CACHED 0xCAC4ED00u
+#define HEAP_BLOCK_MAGIC(node, state) ((uint32_t)((uintptr_t)(node) >> 2) ^ (state))
+#endif
 
-static bool __heap_mgr_checkHeapPool(void);
-static bool __heap_mgr_checkHeapBlock(void *ptr, uint32_t *size);
-static HeapBlockList *__heap_mgr_getFreeBlock(uint32_t size, bool *memCut);
-static uint32_t __heap_mgr_getMaxFreeBlockSize(void);
+static void __enter_critical(HeapManager *heap);
+static void __exit_critical(HeapManager *heap);
+static void *__internal_malloc(HeapManager *heap, uint32_t size);
+static void __internal_free(HeapManager *heap, void *ptr);
+
+static bool __heap_mgr_checkHeapPool(HeapManager *heap);
+static bool __heap_mgr_checkHeapBlock(HeapManager *heap, void *ptr, uint32_t *size);
+static void __heap_mgr_logHeapPool(HeapManager *heap);
+#if (HEAP_MANAGER_USE_TLSF == 0)
+static HeapBlockList *__heap_mgr_getFreeBlock(HeapManager *heap, uint32_t size, uint32_t *maxOther);
+static uint32_t __heap_mgr_getMaxFreeBlockSize(HeapManager *heap);
+#endif
 
 static HeapManager __heapMgr;
 
 /**
- * @brief  Internal malloc memery from Heap manager
+ * @brief  Round the request size up to the block granularity
  * @param  size
- * @retval Adress of the block
+ * @retval Aligned size
  */
-static void *__internal_malloc(uint32_t size)
+static uint32_t __heap_mgr_alignSize(uint32_t size)
 {
-    uint32_t free_size = __heap_mgr_getMaxFreeBlockSize();
-    if (size && free_size >= size)
+    uint32_t currentSize = (size + sizeof(void *) - 1) & ~(uint32_t)(sizeof(void *) - 1);
+    if (currentSize < HEAP_MIN_BLOCK_SIZE)
     {
-        HeapBlockList *ptr = __heapMgr.head;
-        HeapBlockList *free_block = NULL;
-        uint32_t n = size / sizeof(void *);
-        uint32_t currentSize = n * sizeof(void *);
-        if (size % sizeof(void *) != 0)
-        {
-            currentSize += sizeof(void *);
-        }
-        bool isNeedCut = false;
-        HeapBlockList *node = __heap_mgr_getFreeBlock(currentSize, &isNeedCut);
-        if (node == NULL)
+        currentSize = HEAP_MIN_BLOCK_SIZE;
+    }
+    return currentSize;
+}
+/**
+ * @brief  Get the physical next block
+ * @param  heap
+ * @param  node
+ * @retval Next block, NULL if node is the last one
+ */
+static inline HeapBlockList *__heap_mgr_nextBlock(HeapManager *heap, HeapBlockList *node)
+{
+#if (HEAP_MANAGER_BLOCK_LAYOUT == HEAP_BLOCK_LAYOUT_BOUNDARY_TAG)
+    HeapBlockList *next = (HeapBlockList *)((uint8_t *)node + sizeof(HeapBlockList) + node->size);
+    return ((void *)next < heap->heapEnd) ? next : NULL;
+#else
+    (void)heap;
+    return node->next;
+#endif
+}
+/**
+ * @brief  Get the physical previous block if it is free
+ * @param  node
+ * @retval Previous block, NULL if there is none or it is used
+ */
+static inline HeapBlockList *__heap_mgr_prevFreeBlock(HeapBlockList *node)
+{
+#if (HEAP_MANAGER_BLOCK_LAYOUT == HEAP_BLOCK_LAYOUT_BOUNDARY_TAG)
+    if (!node->isPrevFree)
+    {
+        return NULL;
+    }
+    uint32_t prevSize = *((uint32_t *)node - 1); // footer of the previous block
+    return (HeapBlockList *)((uint8_t *)node - prevSize - sizeof(HeapBlockList));
+#else
+    HeapBlockList *prev = node->prev;
+    return (prev != NULL && prev->isOccupied == 0) ? prev : NULL;
+#endif
+}
+/**
+ * @brief  Set the block state, keep the footer and the neighbour flag up to date
+ * @param  heap
+ * @param  node
+ * @param  occupied
+ * @retval void
+ */
+static inline void __heap_mgr_setOccupied(HeapManager *heap, HeapBlockList *node, bool occupied)
+{
+    node->isOccupied = occupied;
+#if (HEAP_MANAGER_USE_BLOCK_CHECK == 1)
+    node->magic = HEAP_BLOCK_MAGIC(node, occupied ? HEAP_BLOCK_MAGIC_USED : HEAP_BLOCK_MAGIC_FREE);
+#endif
+#if (HEAP_MANAGER_BLOCK_LAYOUT == HEAP_BLOCK_LAYOUT_BOUNDARY_TAG)
+    HeapBlockList *next = __heap_mgr_nextBlock(heap, node);
+    if (!occupied)
+    {
+        *(uint32_t *)((uint8_t *)node + sizeof(HeapBlockList) + node->size - HEAP_FOOTER_SIZE) = node->size;
+    }
+    if (next != NULL)
+    {
+        next->isPrevFree = !occupied;
+    }
+#else
+    (void)heap;
+#endif
+}
+/**
+ * @brief  Move the compaction cursor back to a block whose neighbourhood changed
+ * @param  heap
+ * @param  node: new or grown free block, merged block or block in front of an unpinned one
+ * @retval void
+ */
+static inline void __heap_handle_rewind(HeapManager *heap, HeapBlockList *node)
+{
+#if (HEAP_MANAGER_USE_HANDLE == 1)
+    if (node < heap->compactCursor)
+    {
+        heap->compactCursor = node;
+    }
+#else
+    (void)heap;
+    (void)node;
+#endif
+}
+/**
+ * @brief  Absorb the physical next block into node, the state of node is not changed
+ * @param  heap
+ * @param  node
+ * @param  next: physical next block of node
+ * @retval void
+ */
+static void __heap_mgr_mergeNext(HeapManager *heap, HeapBlockList *node, HeapBlockList *next)
+{
+#if (HEAP_MANAGER_USE_ZERO_TRACK == 1)
+    // Footer of node, header and list links of next end up in the payload
+    uint8_t *junction = (uint8_t *)node + sizeof(HeapBlockList) + node->size - HEAP_FOOTER_SIZE;
+    bool zero = node->isZero && next->isZero;
+#endif
+    heap->blockNum--;
+    node->size += sizeof(HeapBlockList) + next->size;
+    __heap_handle_rewind(heap, node); // the cursor may point at next
+#if (HEAP_MANAGER_USE_BLOCK_CHECK == 1)
+    next->magic = 0; // the header is payload now, a stale pointer to it must not pass the check
+#endif
+#if (HEAP_MANAGER_BLOCK_LAYOUT == HEAP_BLOCK_LAYOUT_LIST)
+    node->next = next->next;
+    if (node->next != NULL)
+    {
+        node->next->prev = node;
+    }
+#endif
+#if (HEAP_MANAGER_USE_ZERO_TRACK == 1)
+    if (zero)
+    {
+        memset(junction, 0, HEAP_FOOTER_SIZE + sizeof(HeapBlockList) + HEAP_FREE_META_HEAD);
+    }
+    node->isZero = zero;
+#endif
+}
+#if (HEAP_MANAGER_USE_PROFILE == 1)
+/**
+ * @brief  Record the allocation site of a block
+ * @param  node
+ * @param  file: NULL for a user tag
+ * @param  line: line or user tag ID
+ * @retval void
+ */
+static inline void __heap_mgr_setSite(HeapBlockList *node, const char *file, uint32_t line)
+{
+    node->file = file;
+    node->line = line;
+}
+#endif
+#if (HEAP_MANAGER_USE_BLOCK_CHECK == 1)
+/**
+ * @brief  O(1) check that ptr is the payload of a block of this heap in the given state
+ * @param  heap
+ * @param  ptr
+ * @param  state: HEAP_BLOCK_MAGIC_USED, HEAP_BLOCK_MAGIC_FREE or HEAP_BLOCK_MAGIC_CACHED
+ * @retval true if the header matches
+ */
+static inline bool __heap_mgr_matchMagic(HeapManager *heap, void *ptr, uint32_t state)
+{
+    if (((uintptr_t)ptr & (sizeof(void *) - 1)) != 0 || (uint8_t *)ptr < (uint8_t *)heap->heapTop + sizeof(HeapBlockList) || ptr >= heap->heapEnd)
+    {
+        return false;
+    }
+    HeapBlockList *node = (HeapBlockList *)((uint8_t *)ptr - sizeof(HeapBlockList));
+    return node->magic == HEAP_BLOCK_MAGIC(node, state) && node->size <= (uint32_t)((uint8_t *)heap->heapEnd - (uint8_t *)ptr);
+}
+#endif
+/**
+ * @brief  Cut the tail of a block into a new free block if it is large enough
+ * @param  heap
+ * @param  node: block to cut
+ * @param  size: size to keep in node
+ * @retval The new free block, NULL if no cut was done
+ */
+static HeapBlockList *__heap_mgr_splitBlock(HeapManager *heap, HeapBlockList *node, uint32_t size)
+{
+    if (node->size < size + sizeof(HeapBlockList) + HEAP_MIN_BLOCK_SIZE)
+    {
+        return NULL;
+    }
+    HeapBlockList *free_block = (HeapBlockList *)((uint8_t *)node + sizeof(HeapBlockList) + size);
+    free_block->size = node->size - size - sizeof(HeapBlockList);
+#if (HEAP_MANAGER_USE_ZERO_TRACK == 1)
+    free_block->isZero = !node->isOccupied && node->isZero; // a used block may hold data behind size
+#endif
+#if (HEAP_MANAGER_BLOCK_LAYOUT == HEAP_BLOCK_LAYOUT_BOUNDARY_TAG)
+    free_block->isPrevFree = !node->isOccupied;
+#else
+    free_block->next = node->next;
+    free_block->prev = node;
+    if (free_block->next != NULL)
+    {
+        free_block->next->prev = free_block;
+    }
+    node->next = free_block;
+#endif
+    node->size = size;
+    heap->blockNum++;
+    __heap_mgr_setOccupied(heap, free_block, false);
+    return free_block;
+}
+
+#if (HEAP_MANAGER_USE_TLSF == 1)
+#if defined(__GNUC__)
+#define __heap_tlsf_ffs(x) ((uint32_t)__builtin_ctz(x))
+#define __heap_tlsf_fls(x) ((uint32_t)(31 - __builtin_clz(x)))
+#else
+static uint32_t __heap_tlsf_ffs(uint32_t x)
+{
+    uint32_t bit = 0;
+    while (!(x & 1u))
+    {
+        x >>= 1;
+        bit++;
+    }
+    return bit;
+}
+static uint32_t __heap_tlsf_fls(uint32_t x)
+{
+    uint32_t bit = 0;
+    while (x >>= 1)
+    {
+        bit++;
+    }
+    return bit;
+}
+#endif
+#define __FREE_LINK(block) ((HeapFreeLink *)((uint8_t *)(block) + sizeof(HeapBlockList)))
+
+/**
+ * @brief  Map a block size to its first/second level list
+ * @param  size
+ * @param  fl: first level index
+ * @param  sl: second level index
+ * @retval void
+ */
+static void __heap_tlsf_mapping(uint32_t size, uint32_t *fl, uint32_t *sl)
+{
+    if (size < (1u << HEAP_TLSF_FL_SHIFT))
+    {
+        *fl = 0;
+        *sl = size >> HEAP_TLSF_ALIGN_LOG2;
+    }
+    else
+    {
+        uint32_t f = __heap_tlsf_fls(size);
+        *sl = (size >> (f - HEAP_TLSF_SL_LOG2)) ^ HEAP_TLSF_SL_COUNT;
+        *fl = f - (HEAP_TLSF_FL_SHIFT - 1);
+    }
+}
+/**
+ * @brief  Insert a free block in the segregated lists
+ * @param  block
+ * @retval void
+ */
+static void __heap_tlsf_insertBlock(HeapManager *heap, HeapBlockList *block)
+{
+    uint32_t fl, sl;
+    __heap_tlsf_mapping(block->size, &fl, &sl);
+    HeapBlockList *first = heap->freeLists[fl][sl];
+    __FREE_LINK(block)->prevFree = NULL;
+    __FREE_LINK(block)->nextFree = first;
+    if (first != NULL)
+    {
+        __FREE_LINK(first)->prevFree = block;
+    }
+    heap->freeLists[fl][sl] = block;
+    heap->flBitmap |= (1u << fl);
+    heap->slBitmap[fl] |= (1u << sl);
+}
+/**
+ * @brief  Remove a free block from the segregated lists
+ * @param  block
+ * @retval void
+ */
+static void __heap_tlsf_removeBlock(HeapManager *heap, HeapBlockList *block)
+{
+    uint32_t fl, sl;
+    __heap_tlsf_mapping(block->size, &fl, &sl);
+    HeapBlockList *prev = __FREE_LINK(block)->prevFree;
+    HeapBlockList *next = __FREE_LINK(block)->nextFree;
+    if (next != NULL)
+    {
+        __FREE_LINK(next)->prevFree = prev;
+    }
+    if (prev != NULL)
+    {
+        __FREE_LINK(prev)->nextFree = next;
+    }
+    else
+    {
+        heap->freeLists[fl][sl] = next;
+        if (next == NULL)
         {
-            HEAP_MANAGER_INFO("malloc size = %d faile !!!!!\n", size);
-            heap_mgr_logHeapPool();
-            return (void *)(NULL);
+            heap->slBitmap[fl] &= ~(1u << sl);
+            if (heap->slBitmap[fl] == 0)
+            {
+                heap->flBitmap &= ~(1u << fl);
+            }
         }
-        node->isOccupied = 1;
-        uint8_t *p = (uint8_t *)node;
-        if (isNeedCut)
+    }
+}
+/**
+ * @brief  Find a free block of at least size bytes
+ * @param  size: aligned size
+ * @retval Free block, NULL if none
+ */
+static HeapBlockList *__heap_tlsf_findFreeBlock(HeapManager *heap, uint32_t size)
+{
+    uint32_t fl, sl;
+    // Round up to the next list so that any block of the list fits
+    uint32_t searchSize = size;
+    if (size >= (1u << HEAP_TLSF_FL_SHIFT))
+    {
+        searchSize += (1u << (__heap_tlsf_fls(size) - HEAP_TLSF_SL_LOG2)) - 1;
+    }
+    __heap_tlsf_mapping(searchSize, &fl, &sl);
+    if (fl < HEAP_TLSF_FL_COUNT)
+    {
+        uint32_t slMap = heap->slBitmap[fl] & (~0u << sl);
+        if (slMap == 0)
         {
-            p += sizeof(HeapBlockList) + currentSize;
-            free_block = (HeapBlockList *)(p);
-            free_block->size = node->size - currentSize - sizeof(HeapBlockList);
-            free_block->isOccupied = 0;
-            free_block->next = node->next;
-            free_block->prev = node;
-            if (free_block->next != NULL)
+            uint32_t flMap = (fl + 1 < 32) ? (heap->flBitmap & (~0u << (fl + 1))) : 0;
+            if (flMap != 0)
             {
-                free_block->next->prev = free_block;
+                fl = __heap_tlsf_ffs(flMap);
+                slMap = heap->slBitmap[fl];
             }
-            node->next = free_block;
-            node->size = currentSize;
         }
-
-        p = (uint8_t *)node;
-        p += sizeof(HeapBlockList);
-        if (__heap_mgr_checkHeapPool() == false)
+        if (slMap != 0)
         {
-            node->isOccupied = 0;
-            return NULL;
+            return heap->freeLists[fl][__heap_tlsf_ffs(slMap)];
         }
-        return (void *)(p);
     }
+    // Nearly out of memory: the list of the request itself may still hold a fitting block
+    __heap_tlsf_mapping(size, &fl, &sl);
+    HeapBlockList *block = heap->freeLists[fl][sl];
+    while (block != NULL && block->size < size)
+    {
+        block = __FREE_LINK(block)->nextFree;
+    }
+    return block;
+}
+/**
+ * @brief  Get the largest request sure to succeed, O(1): the lower edge of the highest
+ *         non empty list, at most 1 / HEAP_TLSF_SL_COUNT below the largest free block
+ * @param  heap
+ * @retval size
+ */
+static uint32_t __heap_tlsf_getMaxFreeBlockSize(HeapManager *heap)
+{
+    if (heap->flBitmap == 0)
+    {
+        return 0;
+    }
+    uint32_t fl = __heap_tlsf_fls(heap->flBitmap);
+    uint32_t sl = __heap_tlsf_fls(heap->slBitmap[fl]);
+    if (fl == 0)
+    {
+        return sl << HEAP_TLSF_ALIGN_LOG2;
+    }
+    return (sl | HEAP_TLSF_SL_COUNT) << (fl + HEAP_TLSF_FL_SHIFT - 1 - HEAP_TLSF_SL_LOG2);
+}
+#endif
 
-    return NULL;
+/**
+ * @brief  Add a free block to the free index and the statistics
+ * @param  heap
+ * @param  block
+ * @retval void
+ */
+static void __heap_mgr_insertFree(HeapManager *heap, HeapBlockList *block)
+{
+    heap->freeBlockNum++;
+    heap->freeBytes += block->size;
+    __heap_handle_rewind(heap, block);
+#if (HEAP_MANAGER_USE_TLSF == 1)
+    __heap_tlsf_insertBlock(heap, block);
+#else
+    if (block->size >= heap->maxFreeBlock)
+    {
+        heap->maxFreeBlock = block->size;
+        heap->maxFreeDirty = false;
+    }
+#endif
+}
+/**
+ * @brief  Remove a free block from the free index and the statistics
+ * @param  heap
+ * @param  block
+ * @retval void
+ */
+static void __heap_mgr_removeFree(HeapManager *heap, HeapBlockList *block)
+{
+    heap->freeBlockNum--;
+    heap->freeBytes -= block->size;
+#if (HEAP_MANAGER_USE_TLSF == 1)
+    __heap_tlsf_removeBlock(heap, block);
+#else
+    if (block->size == heap->maxFreeBlock)
+    {
+        heap->maxFreeDirty = true; // refreshed by the next malloc walk
+    }
+#endif
+}
+/**
+ * @brief  Remember the peak usage
+ * @param  heap
+ * @retval void
+ */
+static void __heap_mgr_updatePeak(HeapManager *heap)
+{
+    uint32_t used = heap->heapTotalSize - heap->blockNum * sizeof(HeapBlockList) - heap->freeBytes;
+    if (used > heap->peakUsedBytes)
+    {
+        heap->peakUsedBytes = used;
+    }
+}
+/**
+ * @brief  Take a free block of at least size bytes out of the free blocks
+ * @param  heap
+ * @param  size: aligned size
+ * @retval Free block, NULL if none
+ */
+static HeapBlockList *__heap_mgr_takeFreeBlock(HeapManager *heap, uint32_t size)
+{
+#if (HEAP_MANAGER_USE_TLSF == 1)
+    HeapBlockList *node = __heap_tlsf_findFreeBlock(heap, size);
+    if (node != NULL)
+    {
+        __heap_mgr_removeFree(heap, node);
+    }
+#else
+    if (!heap->maxFreeDirty && heap->maxFreeBlock < size)
+    {
+        return NULL;
+    }
+    uint32_t maxOther = 0;
+    HeapBlockList *node = __heap_mgr_getFreeBlock(heap, size, &maxOther);
+    if (node != NULL)
+    {
+        __heap_mgr_removeFree(heap, node);
+    }
+    heap->maxFreeBlock = maxOther;
+    heap->maxFreeDirty = false;
+#endif
+    return node;
+}
+/**
+ * @brief  Internal malloc memery from Heap manager
+ * @param  size
+ * @retval Adress of the block
+ */
+static void *__internal_malloc(HeapManager *heap, uint32_t size)
+{
+    if (size == 0 || !heap->isEnable)
+    {
+        return NULL;
+    }
+    uint32_t currentSize = __heap_mgr_alignSize(size);
+    HeapBlockList *node = __heap_mgr_takeFreeBlock(heap, currentSize);
+    if (node == NULL)
+    {
+        heap->failedCount++;
+        HEAP_MANAGER_INFO("malloc size = %d faile !!!!!\n", size);
+        return (void *)(NULL);
+    }
+    HeapBlockList *free_block = __heap_mgr_splitBlock(heap, node, currentSize);
+    if (free_block != NULL)
+    {
+        __heap_mgr_insertFree(heap, free_block);
+    }
+    __heap_mgr_setOccupied(heap, node, true);
+#if (HEAP_MANAGER_USE_PROFILE == 1)
+    __heap_mgr_setSite(node, NULL, 0);
+#endif
+    heap->mallocCount++;
+    __heap_mgr_updatePeak(heap);
+
+    uint8_t *p = (uint8_t *)node;
+    p += sizeof(HeapBlockList);
+    if (__heap_mgr_checkHeapPool(heap) == false)
+    {
+        __heap_mgr_setOccupied(heap, node, false);
+        return NULL;
+    }
+    return (void *)(p);
 }
 /**
  * @brief  Internal free memery from Heap manager
  * @param  ptr
  * @retval void
  */
-static void __internal_free(void *ptr)
+static void __internal_free(HeapManager *heap, void *ptr)
 {
     if (ptr == NULL)
         return;
+    if (!heap->isEnable)
+    {
+        heap->invalidFreeCount++;
+        HEAP_MANAGER_ERROR("free %p on a destroyed heap\n", ptr);
+        return;
+    }
+#if (HEAP_MANAGER_USE_BLOCK_CHECK == 1)
+    if (!__heap_mgr_checkHeapBlock(heap, ptr, NULL))
+    {
+        heap->invalidFreeCount++;
+        HEAP_MANAGER_ERROR("free invalid pointer %p (double free or not from this heap)\n", ptr);
+        return;
+    }
+#endif
     HeapBlockList *curr = (HeapBlockList *)((uint8_t *)ptr - sizeof(HeapBlockList));
-    if (curr < (HeapBlockList *)__heapMgr.heapTop || curr >= (HeapBlockList *)__heapMgr.heapEnd)
+    if (curr < (HeapBlockList *)heap->heapTop || curr >= (HeapBlockList *)heap->heapEnd)
     {
         return;
     }
 
-    curr->isOccupied = 0; // set to empty
+    heap->freeCount++;
+#if (HEAP_MANAGER_USE_ZERO_TRACK == 1)
+    curr->isZero = curr->size <= HEAP_ZERO_ON_FREE_SIZE;
+    if (curr->isZero)
+    {
+        memset(ptr, 0, curr->size);
+    }
+#endif
 
     //  (Merge Next)
     //
-    HeapBlockList *next_node = curr->next;
+    HeapBlockList *next_node = __heap_mgr_nextBlock(heap, curr);
     if (next_node != NULL && next_node->isOccupied == 0)
     {
-        curr->size += sizeof(HeapBlockList) + next_node->size;
-        curr->next = next_node->next;
-        if (curr->next != NULL)
-        {
-            curr->next->prev = curr;
-        }
+        __heap_mgr_removeFree(heap, next_node);
+        __heap_mgr_mergeNext(heap, curr, next_node);
     }
     //  (Merge Prev)
-    HeapBlockList *prev_node = curr->prev;
-    if (prev_node != NULL && prev_node->isOccupied == 0)
+    HeapBlockList *prev_node = __heap_mgr_prevFreeBlock(curr);
+    if (prev_node != NULL)
     {
-
-        prev_node->size += sizeof(HeapBlockList) + curr->size;
-        prev_node->next = curr->next;
-        if (prev_node->next != NULL)
-        {
-            prev_node->next->prev = prev_node;
-        }
+        __heap_mgr_removeFree(heap, prev_node);
+        __heap_mgr_mergeNext(heap, prev_node, curr);
+        curr = prev_node;
     }
+    __heap_mgr_setOccupied(heap, curr, false); // set to empty
+    __heap_mgr_insertFree(heap, curr);
 }
 
+#if (HEAP_MANAGER_USE_TLSF == 0)
 /**
  * @brief  Get max free block size
  * @param  NONE
  * @retval size
  */
-static uint32_t __heap_mgr_getMaxFreeBlockSize(void)
+static uint32_t __heap_mgr_getMaxFreeBlockSize(HeapManager *heap)
 {
-    HeapBlockList *node = __heapMgr.head;
+    HeapBlockList *node = heap->head;
     uint32_t size = 0;
     while (node)
     {
@@ -143,53 +629,60 @@ static uint32_t __heap_mgr_getMaxFreeBlockSize(void)
                 size = node->size;
             }
         }
-        node = node->next;
+        node = __heap_mgr_nextBlock(heap, node);
     }
     return size;
 }
 /**
- * @brief  Get min free block
- * @param  NONE
- * @retval size
+ * @brief  Get min free block, the max free block size is refreshed in the same walk
+ * @param  size
+ * @param  maxOther: max size of the other free blocks
+ * @retval Free block
  */
-static HeapBlockList *__heap_mgr_getFreeBlock(uint32_t size, bool *memCut)
+static HeapBlockList *__heap_mgr_getFreeBlock(HeapManager *heap, uint32_t size, uint32_t *maxOther)
 {
-    HeapBlockList *current_node = __heapMgr.head;
+    HeapBlockList *current_node = heap->head;
     HeapBlockList *ret_node = NULL;
+    HeapBlockList *max_node = NULL;
     uint32_t min_size = 0xffffffff;
-    *memCut = false;
+    uint32_t max_size = 0;
+    uint32_t second_size = 0;
     while (current_node)
     {
-        if (current_node->isOccupied == 0 && current_node->size >= size) // 块是否空闲
+        if (current_node->isOccupied == 0) // 块是否空闲
         {
-            bool current_cut = false;
-            if (current_node->size >= (size + sizeof(HeapBlockList) + (sizeof(void *))))
-                current_cut = true;
-
-            if (current_node->size < min_size)
+            if (current_node->size >= size && current_node->size < min_size)
             {
                 min_size = current_node->size;
-                *memCut = current_cut;
                 ret_node = current_node;
-
-                if (min_size == size)
-                    break;
+            }
+            if (current_node->size > max_size)
+            {
+                second_size = max_size;
+                max_size = current_node->size;
+                max_node = current_node;
+            }
+            else if (current_node->size > second_size)
+            {
+                second_size = current_node->size;
             }
         }
-        current_node = current_node->next;
+        current_node = __heap_mgr_nextBlock(heap, current_node);
     }
+    *maxOther = (ret_node == max_node) ? second_size : max_size;
     return ret_node;
 }
+#endif
 
 /**
  * @brief Check Heap block Pool
  * @param  NONE
  * @retval size
  */
-static bool __heap_mgr_checkHeapPool(void)
+static bool __heap_mgr_checkHeapPool(HeapManager *heap)
 {
 #if HEAP_DEBUG_CHECK == 1
-    HeapBlockList *node = __heapMgr.head;
+    HeapBlockList *node = heap->head;
     bool status = true;
     uint32_t size = 0;
     uint32_t cnt = 0;
@@ -198,33 +691,45 @@ static bool __heap_mgr_checkHeapPool(void)
     {
         cnt++;
         size += node->size;
-        node = node->next;
+        node = __heap_mgr_nextBlock(heap, node);
     }
 
-    if (size < (__heapMgr.heapTotalSize - cnt * sizeof(HeapBlockList)))
+    if (size < (heap->heapTotalSize - cnt * sizeof(HeapBlockList)))
     {
         HEAP_MANAGER_INFO("__heap_mgr_checkHeapPool err now only have %d block, size = %d!!!\n", cnt, size);
-        heap_mgr_logHeapPool();
+        __heap_mgr_logHeapPool(heap);
         status = false;
     }
     return status;
 #else
+    (void)heap;
     return true;
 #endif
 }
 
 /**
- * @brief Check Heap block Pool
- * @param  NONE
- * @retval size
+ * @brief  Check that ptr is an used block of the heap, O(1) with HEAP_MANAGER_USE_BLOCK_CHECK
+ * @param  heap
+ * @param  ptr
+ * @param  size: Output size of the block, can be NULL
+ * @retval true if ptr can be freed
  */
-static bool __heap_mgr_checkHeapBlock(void *ptr, uint32_t *size)
+static bool __heap_mgr_checkHeapBlock(HeapManager *heap, void *ptr, uint32_t *size)
 {
-    if ((ptr < __heapMgr.heapTop) || (ptr > __heapMgr.heapEnd))
+#if (HEAP_MANAGER_USE_BLOCK_CHECK == 1)
+    if (!__heap_mgr_matchMagic(heap, ptr, HEAP_BLOCK_MAGIC_USED))
+    {
+        return false;
+    }
+    if (size != NULL)
+        *size = ((HeapBlockList *)((uint8_t *)ptr - sizeof(HeapBlockList)))->size;
+    return true;
+#else
+    if ((ptr < heap->heapTop) || (ptr > heap->heapEnd))
     {
         return false; // Adress no valid
     }
-    HeapBlockList *node = __heapMgr.head;
+    HeapBlockList *node = heap->head;
     uint8_t *current_p = NULL;
     while (node)
     {
@@ -244,187 +749,1850 @@ static bool __heap_mgr_checkHeapBlock(void *ptr, uint32_t *size)
                 return true;
             }
         }
-        node = node->next;
+        node = __heap_mgr_nextBlock(heap, node);
     }
     return false;
+#endif
 }
-static void *__internal_heap_mgr_realloc(void *ptr, uint32_t new_size)
-{
-
+/**
+ * @brief  Give the tail of an used block back to the free blocks
+ * @param  heap
+ * @param  node: used block
+ * @param  size: aligned size to keep in node
+ * @retval void
+ */
+static void __heap_mgr_releaseTail(HeapManager *heap, HeapBlockList *node, uint32_t size)
+{
+    HeapBlockList *tail = __heap_mgr_splitBlock(heap, node, size);
+    if (tail == NULL)
+    {
+        return;
+    }
+    HeapBlockList *next = __heap_mgr_nextBlock(heap, tail);
+    if (next != NULL && next->isOccupied == 0)
+    {
+        __heap_mgr_removeFree(heap, next);
+        __heap_mgr_mergeNext(heap, tail, next);
+        __heap_mgr_setOccupied(heap, tail, false);
+    }
+    __heap_mgr_insertFree(heap, tail);
+}
+static void *__internal_heap_mgr_realloc(HeapManager *heap, void *ptr, uint32_t new_size)
+{
+    if (!heap->isEnable)
+    {
+        return NULL; // ptr is kept, a free of it is refused as well
+    }
     if (ptr == NULL)
     {
-        return __internal_malloc(new_size);
+        return __internal_malloc(heap, new_size);
     }
     if (new_size == 0)
     {
-        __internal_free(ptr);
+        __internal_free(heap, ptr);
+        return NULL;
+    }
+#if (HEAP_MANAGER_USE_BLOCK_CHECK == 1)
+    if (!__heap_mgr_checkHeapBlock(heap, ptr, NULL))
+    {
+        heap->invalidFreeCount++;
+        HEAP_MANAGER_ERROR("realloc invalid pointer %p (freed or not from this heap)\n", ptr);
         return NULL;
     }
-    uint32_t preSize = 0;
-    if ((ptr < __heapMgr.heapTop) || (ptr >= __heapMgr.heapEnd))
+#endif
+    if ((ptr < heap->heapTop) || (ptr >= heap->heapEnd))
     {
         return NULL;
     }
     HeapBlockList *node = (HeapBlockList *)((uint8_t *)ptr - sizeof(HeapBlockList));
     uint32_t old_size = node->size;
-    if (old_size >= new_size)
+    uint32_t aligned_size = __heap_mgr_alignSize(new_size);
+    // Shrink in place
+    if (old_size >= aligned_size)
+    {
+        __heap_mgr_releaseTail(heap, node, aligned_size);
+        return ptr;
+    }
+    // Grow in place by absorbing the next free block
+    HeapBlockList *next = __heap_mgr_nextBlock(heap, node);
+    if (next != NULL && next->isOccupied == 0 && old_size + sizeof(HeapBlockList) + next->size >= aligned_size)
     {
+        __heap_mgr_removeFree(heap, next);
+#if (HEAP_MANAGER_USE_ZERO_TRACK == 1)
+        node->isZero = 0; // the bit is only kept up to date on free blocks
+#endif
+        __heap_mgr_mergeNext(heap, node, next);
+        __heap_mgr_releaseTail(heap, node, aligned_size);
+        __heap_mgr_setOccupied(heap, node, true);
+        __heap_mgr_updatePeak(heap);
+#if (HEAP_MANAGER_USE_TLSF == 0)
+        if (heap->maxFreeDirty)
+        {
+            // The largest free block was absorbed, find the new one now (one walk, like a best-fit malloc)
+            // so that heap_mgr_getStats stays O(1)
+            heap->maxFreeBlock = __heap_mgr_getMaxFreeBlockSize(heap);
+            heap->maxFreeDirty = false;
+        }
+#endif
         return ptr;
     }
-    void *new_ptr = __internal_malloc(new_size);
+    void *new_ptr = __internal_malloc(heap, new_size);
     if (new_ptr != NULL)
     {
+#if (HEAP_MANAGER_USE_PROFILE == 1)
+        __heap_mgr_setSite((HeapBlockList *)((uint8_t *)new_ptr - sizeof(HeapBlockList)), node->file, node->line);
+#endif
         memcpy(new_ptr, ptr, old_size);
-        __internal_free(ptr);
+        __internal_free(heap, ptr);
         return new_ptr;
     }
     return NULL;
 }
 
-static void __enter_critical()
+/**
+ * @brief  Internal aligned malloc, the leading slack is split back into the free blocks
+ * @param  heap
+ * @param  align: power of 2
+ * @param  size
+ * @retval Adress of the block
+ */
+static void *__internal_aligned_malloc(HeapManager *heap, uint32_t align, uint32_t size)
+{
+    if (align <= sizeof(void *))
+    {
+        return __internal_malloc(heap, size);
+    }
+    if (size == 0 || (align & (align - 1)) != 0 || !heap->isEnable)
+    {
+        return NULL;
+    }
+    uint32_t currentSize = __heap_mgr_alignSize(size);
+    // Worst case: the leading slack has to hold a whole free block
+    HeapBlockList *node = __heap_mgr_takeFreeBlock(heap, currentSize + align + sizeof(HeapBlockList) + HEAP_MIN_BLOCK_SIZE);
+    if (node == NULL)
+    {
+        heap->failedCount++;
+        HEAP_MANAGER_INFO("aligned malloc size = %d align = %d faile !!!!!\n", size, align);
+        return NULL;
+    }
+    uintptr_t payload = (uintptr_t)node + sizeof(HeapBlockList);
+    uintptr_t aligned = (payload + align - 1) & ~(uintptr_t)(align - 1);
+    if (aligned != payload && aligned - payload < sizeof(HeapBlockList) + HEAP_MIN_BLOCK_SIZE)
+    {
+        aligned = (payload + sizeof(HeapBlockList) + HEAP_MIN_BLOCK_SIZE + align - 1) & ~(uintptr_t)(align - 1);
+    }
+    if (aligned != payload)
+    {
+        // Leading slack becomes a free block in front of the aligned block
+        HeapBlockList *lead = node;
+        node = __heap_mgr_splitBlock(heap, lead, (uint32_t)(aligned - payload - sizeof(HeapBlockList)));
+        __heap_mgr_setOccupied(heap, lead, false);
+        __heap_mgr_insertFree(heap, lead);
+    }
+    __heap_mgr_releaseTail(heap, node, currentSize);
+    __heap_mgr_setOccupied(heap, node, true);
+#if (HEAP_MANAGER_USE_PROFILE == 1)
+    __heap_mgr_setSite(node, NULL, 0);
+#endif
+    heap->mallocCount++;
+    __heap_mgr_updatePeak(heap);
+    return (void *)aligned;
+}
+
+static void __enter_critical(HeapManager *heap)
 {
-    if (__heapMgr.enter_critical && __heapMgr.exit_critical)
+    if (heap->enter_critical && heap->exit_critical)
     {
-        __heapMgr.enter_critical();
+        heap->enter_critical();
     }
 }
-static void __exit_critical()
+static void __exit_critical(HeapManager *heap)
 {
-    if (__heapMgr.enter_critical && __heapMgr.exit_critical)
+    if (heap->enter_critical && heap->exit_critical)
     {
-        __heapMgr.exit_critical();
+        heap->exit_critical();
     }
 }
 
-/************************** Public function ****************************************** */
+#if (HEAP_MANAGER_USE_THREAD_CACHE == 1)
+#include <pthread.h>
+/* The thread cache only fronts the default heap (heap_mgr_malloc/heap_mgr_free) */
+typedef struct
+{
+    void *blocks[HEAP_THREAD_CACHE_CLASS_NUM][HEAP_THREAD_CACHE_DEPTH];
+    uint8_t count[HEAP_THREAD_CACHE_CLASS_NUM];
+} HeapThreadCache;
+
+static _Thread_local HeapThreadCache __threadCache;
+static _Thread_local bool __threadCacheRegistered = false;
+static pthread_key_t __threadCacheKey;
+static pthread_once_t __threadCacheOnce = PTHREAD_ONCE_INIT;
+
+#if (HEAP_MANAGER_USE_BLOCK_CHECK == 1)
+/* Blocks held by a cache are marked so that freeing them again is caught */
+static inline void __heap_cache_setMagic(void *ptr, uint32_t state)
+{
+    HeapBlockList *node = (HeapBlockList *)((uint8_t *)ptr - sizeof(HeapBlockList));
+    node->magic = HEAP_BLOCK_MAGIC(node, state);
+}
+#endif
 
 /**
- * @brief  Initilize the Heap Pool Manager
+ * @brief  Give cached blocks of a class back to the heap under one lock
+ * @param  cache
+ * @param  index: class index
+ * @param  num: number of blocks
+ * @retval void
+ */
+static void __heap_cache_release(HeapThreadCache *cache, uint8_t index, uint8_t num)
+{
+    HeapManager *heap = &__heapMgr;
+    __enter_critical(heap);
+    while (num-- && cache->count[index])
+    {
+        void *ptr = cache->blocks[index][--cache->count[index]];
+#if (HEAP_MANAGER_USE_BLOCK_CHECK == 1)
+        __heap_cache_setMagic(ptr, HEAP_BLOCK_MAGIC_USED);
+#endif
+        __internal_free(heap, ptr);
+    }
+    __exit_critical(heap);
+}
+static void __heap_cache_destructor(void *arg)
+{
+    HeapThreadCache *cache = (HeapThreadCache *)arg;
+    for (uint8_t i = 0; i < HEAP_THREAD_CACHE_CLASS_NUM; i++)
+    {
+        __heap_cache_release(cache, i, HEAP_THREAD_CACHE_DEPTH);
+    }
+}
+static void __heap_cache_createKey(void)
+{
+    pthread_key_create(&__threadCacheKey, __heap_cache_destructor);
+}
+/**
+ * @brief  Get the cache of the calling thread, register it for flush on thread exit
+ * @retval cache
+ */
+static HeapThreadCache *__heap_cache_get(void)
+{
+    if (!__threadCacheRegistered)
+    {
+        pthread_once(&__threadCacheOnce, __heap_cache_createKey);
+        pthread_setspecific(__threadCacheKey, &__threadCache);
+        __threadCacheRegistered = true;
+    }
+    return &__threadCache;
+}
+/**
+ * @brief  Malloc from the thread cache, refill it from the heap in a batch if empty
+ * @param  index: class index
+ * @retval Adress of the block
+ */
+static void *__heap_cache_malloc(uint8_t index)
+{
+    HeapManager *heap = &__heapMgr;
+    HeapThreadCache *cache = __heap_cache_get();
+    if (cache->count[index] == 0)
+    {
+        __enter_critical(heap);
+        while (cache->count[index] < HEAP_THREAD_CACHE_BATCH)
+        {
+            void *p = __internal_malloc(heap, 16u << index);
+            if (p == NULL)
+            {
+                heap->failedCount--; // a short refill is not a failed allocation
+                break;
+            }
+#if (HEAP_MANAGER_USE_BLOCK_CHECK == 1)
+            __heap_cache_setMagic(p, HEAP_BLOCK_MAGIC_CACHED);
+#endif
+            cache->blocks[index][cache->count[index]++] = p;
+        }
+#if (HEAP_MANAGER_USE_MMAP == 0)
+        if (cache->count[index] == 0)
+        {
+            heap->failedCount++; // heap_mgr_malloc returns NULL, with mmap the fallback counts it
+        }
+#endif
+        __exit_critical(heap);
+        if (cache->count[index] == 0)
+            return NULL;
+    }
+    void *ptr = cache->blocks[index][--cache->count[index]];
+#if (HEAP_MANAGER_USE_BLOCK_CHECK == 1)
+    __heap_cache_setMagic(ptr, HEAP_BLOCK_MAGIC_USED);
+#endif
+    return ptr;
+}
+/**
+ * @brief  Keep a freed block in the thread cache, release a batch to the heap if full
+ * @param  ptr
+ * @retval true if the block is cached
+ */
+static bool __heap_cache_free(void *ptr)
+{
+#if (HEAP_MANAGER_USE_BLOCK_CHECK == 1)
+    // Invalid pointers go on to heap_mgr_free_from, which reports them under the lock
+    if (!__heap_mgr_matchMagic(&__heapMgr, ptr, HEAP_BLOCK_MAGIC_USED))
+    {
+        return false;
+    }
+#endif
+    if (ptr < __heapMgr.heapTop || ptr >= __heapMgr.heapEnd)
+    {
+        return false;
+    }
+    uint32_t size = ((HeapBlockList *)((uint8_t *)ptr - sizeof(HeapBlockList)))->size;
+    if (size < 16u || size >= (16u << HEAP_THREAD_CACHE_CLASS_NUM))
+    {
+        return false;
+    }
+    uint8_t index = 0;
+    while ((16u << (index + 1)) <= size)
+    {
+        index++;
+    }
+    HeapThreadCache *cache = __heap_cache_get();
+    if (cache->count[index] == HEAP_THREAD_CACHE_DEPTH)
+    {
+        __heap_cache_release(cache, index, HEAP_THREAD_CACHE_BATCH);
+    }
+#if (HEAP_MANAGER_USE_BLOCK_CHECK == 1)
+    __heap_cache_setMagic(ptr, HEAP_BLOCK_MAGIC_CACHED);
+#endif
+#if (HEAP_MANAGER_USE_PROFILE == 1)
+    __heap_mgr_setSite((HeapBlockList *)((uint8_t *)ptr - sizeof(HeapBlockList)), NULL, 0);
+#endif
+    cache->blocks[index][cache->count[index]++] = ptr;
+    return true;
+}
+#endif
+
+/**
+ * @brief  Set up a heap over a buffer
+ * @param  heap
  * @param  buffer
  * @param  size
- * @retval size
+ * @param  enter_critical
+ * @param  exit_critical
+ * @retval void
  */
-void heap_mgr_init(uint8_t *buffer, uint32_t size, void (*enter_critical)(void), void (*exit_critical)(void))
+static void __heap_mgr_setup(HeapManager *heap, uint8_t *buffer, uint32_t size, void (*enter_critical)(void), void (*exit_critical)(void))
 {
     // 1. Calculate aligned address
     uintptr_t addr = (uintptr_t)buffer;
     uintptr_t aligned_addr = (addr + sizeof(void *) - 1) & ~(sizeof(void *) - 1);
     // 2. Calculate the lost bytes
     uint32_t offset = aligned_addr - addr;
-    __heapMgr.heapTop = (void *)aligned_addr;
-    __heapMgr.heapTotalSize = size - offset;
-    __heapMgr.heapEnd = (uint8_t *)__heapMgr.heapTop + __heapMgr.heapTotalSize;
-    __heapMgr.head = (HeapBlockList *)__heapMgr.heapTop;
-    __heapMgr.head->size = __heapMgr.heapTotalSize - sizeof(HeapBlockList);
-    __heapMgr.head->isOccupied = 0;
-    __heapMgr.head->next = NULL;
-    __heapMgr.head->prev = NULL;
-    __heapMgr.isEnable = true;
-    __heapMgr.enter_critical = enter_critical;
-    __heapMgr.exit_critical = exit_critical;
-    HEAP_MANAGER_INFO("HeapManager Initilize successfully adress:%p ,size : %d KB\n", __heapMgr.heapTop, size / 1024);
+    heap->heapTop = (void *)aligned_addr;
+    heap->heapTotalSize = size - offset;
+    heap->heapEnd = (uint8_t *)heap->heapTop + heap->heapTotalSize;
+    heap->head = (HeapBlockList *)heap->heapTop;
+    heap->head->size = heap->heapTotalSize - sizeof(HeapBlockList);
+#if (HEAP_MANAGER_USE_ZERO_TRACK == 1)
+    heap->head->isZero = 0; // see heap_mgr_initZeroed
+#endif
+#if (HEAP_MANAGER_BLOCK_LAYOUT == HEAP_BLOCK_LAYOUT_BOUNDARY_TAG)
+    heap->head->isPrevFree = 0;
+#else
+    heap->head->next = NULL;
+    heap->head->prev = NULL;
+#endif
+    __heap_mgr_setOccupied(heap, heap->head, false);
+#if (HEAP_MANAGER_USE_TLSF == 1)
+    memset(heap->slBitmap, 0, sizeof(heap->slBitmap));
+    memset(heap->freeLists, 0, sizeof(heap->freeLists));
+    heap->flBitmap = 0;
+#endif
+    heap->blockNum = 1;
+    heap->freeBlockNum = 0;
+    heap->freeBytes = 0;
+    heap->peakUsedBytes = 0;
+    heap->mallocCount = 0;
+    heap->freeCount = 0;
+    heap->failedCount = 0;
+    heap->invalidFreeCount = 0;
+#if (HEAP_MANAGER_USE_MMAP == 1)
+    heap->mappings = NULL;
+    heap->segment = NULL;
+    heap->mappedBytes = 0;
+#endif
+#if (HEAP_MANAGER_USE_TLSF == 0)
+    heap->maxFreeBlock = 0;
+    heap->maxFreeDirty = false;
+#endif
+#if (HEAP_MANAGER_USE_HANDLE == 1)
+    heap->compactCursor = (HeapBlockList *)heap->heapEnd;
+#endif
+    __heap_mgr_insertFree(heap, heap->head);
+#if (HEAP_MANAGER_USE_POOL == 1)
+    memset(heap->pool, 0, sizeof(heap->pool));
+#endif
+#if (HEAP_MANAGER_USE_HANDLE == 1)
+    memset(heap->handles, 0, sizeof(heap->handles));
+#endif
+    heap->isEnable = true;
+    heap->enter_critical = enter_critical;
+    heap->exit_critical = exit_critical;
 }
 /**
- * @brief  Check if the heap manager is already been initilized
- * @param  void
- * @retval true if heap manager is initilized
+ * @brief  Printf every block of a heap
+ * @param  heap
+ * @retval void
  */
-bool heap_mgr_isInitilized()
+static void __heap_mgr_logHeapPool(HeapManager *heap)
 {
-    return __heapMgr.isEnable;
+    HeapBlockList *node = heap->head;
+    while (node)
+    {
+        HeapBlockList *next = __heap_mgr_nextBlock(heap, node);
+        HEAP_MANAGER_INFO("address = %p, is used = %d, next = %p, size = %d\n", node, node->isOccupied, next, node->size);
+        node = next;
+    }
 }
+
+#if (HEAP_MANAGER_USE_MMAP == 1)
+/* Header in front of a directly mapped block */
+typedef struct _HeapMapping
+{
+    struct _HeapMapping *prev;
+    struct _HeapMapping *next;
+    size_t size; // size of the mapping
+} HeapMapping;
+
 /**
- * @brief  Allocate memory and initialize
- * @param  size: Size
- * @retval Pointer to the allocated memory
+ * @brief  Map a large block
+ * @param  heap
+ * @param  size
+ * @retval Adress of the block
  */
-void *heap_mgr_malloc(uint32_t size)
+static void *__heap_mmap_malloc(HeapManager *heap, uint32_t size)
 {
-    void *p = NULL;
-    __enter_critical();
-    p = __internal_malloc(size);
-    __exit_critical();
-    return p;
+    if (!heap->isEnable)
+    {
+        return NULL;
+    }
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t mapSize = ((size_t)size + sizeof(HeapMapping) + page - 1) & ~(page - 1);
+    HeapMapping *mapping = (HeapMapping *)mmap(NULL, mapSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    __enter_critical(heap);
+    if (mapping == MAP_FAILED)
+    {
+        heap->failedCount++;
+        __exit_critical(heap);
+        HEAP_MANAGER_INFO("mmap size = %d faile !!!!!\n", size);
+        return NULL;
+    }
+    mapping->size = mapSize;
+    mapping->prev = NULL;
+    mapping->next = (HeapMapping *)heap->mappings;
+    if (mapping->next != NULL)
+    {
+        mapping->next->prev = mapping;
+    }
+    heap->mappings = mapping;
+    heap->mappedBytes += mapSize;
+    heap->mallocCount++;
+    __exit_critical(heap);
+    return mapping + 1;
 }
 /**
- * @brief  Free the allocated memory
- * @retval void
+ * @brief  Malloc from the segments of a heap, map a new segment if they are all full
+ *         Called with the heap locked
+ * @param  heap
+ * @param  size
+ * @retval Adress of the block
  */
-void heap_mgr_free(void *ptr)
+static void *__heap_segment_malloc(HeapManager *heap, uint32_t size)
 {
-    __enter_critical();
-    __internal_free(ptr);
-    __exit_critical();
+    void *p = NULL;
+    if (!heap->isEnable)
+    {
+        return NULL;
+    }
+    for (HeapManager *segment = heap->segment; segment != NULL && p == NULL; segment = segment->segment)
+    {
+        p = __internal_malloc(segment, size);
+    }
+    if (p == NULL)
+    {
+        size_t page = (size_t)sysconf(_SC_PAGESIZE);
+        size_t mapSize = (size_t)size + sizeof(HeapManager) + 2 * sizeof(HeapBlockList) + HEAP_MIN_BLOCK_SIZE;
+        mapSize = (mapSize < HEAP_MMAP_SEGMENT_SIZE ? HEAP_MMAP_SEGMENT_SIZE : mapSize + page - 1) & ~(page - 1);
+        uint8_t *buffer = (uint8_t *)mmap(NULL, mapSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (buffer == MAP_FAILED)
+        {
+            return NULL;
+        }
+        HeapManager *segment = heap_mgr_create(buffer, (uint32_t)mapSize, NULL, NULL);
+#if (HEAP_MANAGER_USE_ZERO_TRACK == 1)
+        segment->head->isZero = 1; // fresh anonymous pages
+#endif
+        segment->segment = heap->segment;
+        heap->segment = segment;
+        heap->mappedBytes += (uint32_t)mapSize;
+        p = __internal_malloc(segment, size);
+    }
+    if (p != NULL)
+    {
+        heap->failedCount--; // the heap itself counted it as failed
+        heap->mallocCount++;
+    }
+    return p;
 }
 /**
- * @brief  Reallocate memory
- * @param  addrToPtr: Allocated memory address
- * @param  size: new size of the memory
- * @retval Pointer to the allocated memory
+ * @brief  Free a block that is not in the heap buffer, called with the heap locked
+ * @param  heap
+ * @param  ptr
+ * @retval true if ptr was a mapped block or a block of a segment
  */
-void *heap_mgr_realloc(void *ptr, uint32_t new_size)
+static bool __heap_mmap_free(HeapManager *heap, void *ptr)
 {
-    __enter_critical();
-    void *_ptr = __internal_heap_mgr_realloc(ptr, new_size);
-    __exit_critical();
-    return _ptr;
+    for (HeapMapping *mapping = (HeapMapping *)heap->mappings; mapping != NULL; mapping = mapping->next)
+    {
+        if (mapping + 1 != ptr)
+        {
+            continue;
+        }
+        if (mapping->prev != NULL)
+            mapping->prev->next = mapping->next;
+        else
+            heap->mappings = mapping->next;
+        if (mapping->next != NULL)
+            mapping->next->prev = mapping->prev;
+        heap->mappedBytes -= mapping->size;
+        heap->freeCount++;
+        munmap(mapping, mapping->size);
+        return true;
+    }
+    for (HeapManager **link = &heap->segment; *link != NULL; link = &(*link)->segment)
+    {
+        HeapManager *segment = *link;
+        if (ptr < segment->heapTop || ptr >= segment->heapEnd)
+        {
+            continue;
+        }
+        __internal_free(segment, ptr);
+        heap->freeCount++;
+        if (segment->blockNum == 1 && segment->freeBlockNum == 1)
+        {
+            // Empty again, give the pages back
+            uint32_t mapSize = (uint32_t)((uint8_t *)segment->heapEnd - (uint8_t *)segment);
+            *link = segment->segment;
+            heap->mappedBytes -= mapSize;
+            munmap(segment, mapSize);
+        }
+        return true;
+    }
+    return false;
 }
 /**
- * @brief  Allocate memory and initialize to zero (calloc)
- * @param  nmemb: Number of elements
- * @param  size: Size of each element
- * @retval Pointer to the allocated memory
+ * @brief  Unmap every mapped block and every segment of a heap, called with the heap locked
+ * @param  heap
+ * @retval void
  */
-void *heap_mgr_calloc(uint32_t nmemb, uint32_t size)
+static void __heap_mmap_release(HeapManager *heap)
 {
-    if (nmemb && size > (0xFFFFFFFF / nmemb))
+    HeapMapping *mapping = (HeapMapping *)heap->mappings;
+    while (mapping != NULL)
     {
-        return NULL;
+        HeapMapping *next = mapping->next;
+        munmap(mapping, mapping->size);
+        mapping = next;
     }
-    uint32_t total_size = nmemb * size;
-    void *ptr = heap_mgr_malloc(total_size);
-    if (ptr != NULL)
+    HeapManager *segment = heap->segment;
+    while (segment != NULL)
     {
-        memset(ptr, 0, total_size);
+        HeapManager *next = segment->segment;
+        munmap(segment, (size_t)((uint8_t *)segment->heapEnd - (uint8_t *)segment));
+        segment = next;
     }
-    return ptr;
+    heap->mappings = NULL;
+    heap->segment = NULL;
+    heap->mappedBytes = 0;
 }
 /**
- * @brief  Get Heap block Pool Infor
- * @param  NONE
- * @retval size
+ * @brief  Usable size of a block of a heap, its segments or its mappings, called with the heap locked
+ * @param  heap
+ * @param  ptr
+ * @retval size, 0 if the block is unknown
  */
-void heap_mgr_logHeapPool(void)
+static uint32_t __heap_mmap_blockSize(HeapManager *heap, void *ptr)
 {
-    HeapBlockList *node = __heapMgr.head;
-    while (node)
+    for (HeapMapping *mapping = (HeapMapping *)heap->mappings; mapping != NULL; mapping = mapping->next)
+    {
+        if (mapping + 1 == ptr)
+        {
+            return (uint32_t)(mapping->size - sizeof(HeapMapping));
+        }
+    }
+    for (HeapManager *segment = heap; segment != NULL; segment = segment->segment)
     {
-        HEAP_MANAGER_INFO("address = %p, is used = %d, next = %p, size = %d\n", node, node->isOccupied, node->next, node->size);
-        node = node->next;
+        uint32_t size = 0;
+        if (ptr >= segment->heapTop && ptr < segment->heapEnd)
+        {
+#if (HEAP_MANAGER_USE_BLOCK_CHECK == 1)
+            __heap_mgr_checkHeapBlock(segment, ptr, &size);
+#else
+            size = ((HeapBlockList *)((uint8_t *)ptr - sizeof(HeapBlockList)))->size;
+#endif
+            return size;
+        }
     }
+    return 0;
 }
 /**
- * @brief  Get the block
- * @param  ptr block address
- * @retval block infor
+ * @brief  Move a block to a new block of the requested size, anywhere in the heap, its segments or a mapping
+ * @param  heap
+ * @param  ptr
+ * @param  new_size
+ * @retval Adress of the new block, NULL if failed (ptr is kept)
  */
-HeapBlockList *heap_mgr_getHeapBlock(void *ptr)
+static void *__heap_mmap_realloc(HeapManager *heap, void *ptr, uint32_t new_size)
 {
-    if ((ptr < __heapMgr.heapTop) || (ptr > __heapMgr.heapEnd))
+    __enter_critical(heap);
+    uint32_t old_size = __heap_mmap_blockSize(heap, ptr);
+    __exit_critical(heap);
+    if (old_size == 0)
     {
-        return NULL; // Adress no valid
+        return NULL;
     }
-    HeapBlockList *node = __heapMgr.head;
-    uint8_t *current_p = NULL;
-    while (node)
+    if (new_size <= old_size && new_size >= HEAP_MMAP_THRESHOLD && (ptr < heap->heapTop || ptr >= heap->heapEnd))
     {
-        uint32_t current_size = node->size;
-        current_p = (uint8_t *)node + sizeof(HeapBlockList);
-        if ((ptr == current_p) && (ptr < (current_p + current_size)))
-        {
-            return node;
-        }
-        node = node->next;
+        return ptr; // still fits in its mapping
     }
-    return NULL;
+    void *new_ptr = heap_mgr_malloc_from(heap, new_size);
+    if (new_ptr != NULL)
+    {
+        memcpy(new_ptr, ptr, old_size < new_size ? old_size : new_size);
+        heap_mgr_free_from(heap, ptr);
+    }
+    return new_ptr;
 }
+#endif
+
+/************************** Public function ****************************************** */
+
+/**
+ * @brief  Initilize the Heap Pool Manager
+ * @param  buffer
+ * @param  size
+ * @retval size
+ */
+void heap_mgr_init(uint8_t *buffer, uint32_t size, void (*enter_critical)(void), void (*exit_critical)(void))
+{
+    __heap_mgr_setup(&__heapMgr, buffer, size, enter_critical, exit_critical);
+    HEAP_MANAGER_INFO("HeapManager Initilize successfully adress:%p ,size : %d KB\n", __heapMgr.heapTop, size / 1024);
+}
+#if (HEAP_MANAGER_USE_ZERO_TRACK == 1)
+/**
+ * @brief  Initilize the heap over a buffer that is already zero, calloc skips the memset until it is reused
+ * @param  buffer: zero filled, e.g. a static array in .bss
+ * @param  size
+ * @param  enter_critical
+ * @param  exit_critical
+ * @retval void
+ */
+void heap_mgr_initZeroed(uint8_t *buffer, uint32_t size, void (*enter_critical)(void), void (*exit_critical)(void))
+{
+    heap_mgr_init(buffer, size, enter_critical, exit_critical);
+    __heapMgr.head->isZero = 1; // only the free list links and the footer are written by the setup
+}
+#endif
+/**
+ * @brief  Create an independent heap, its control block is placed at the start of the buffer
+ * @param  buffer
+ * @param  size
+ * @param  enter_critical
+ * @param  exit_critical
+ * @retval Heap handle, NULL if the buffer is too small
+ */
+HeapManager *heap_mgr_create(uint8_t *buffer, uint32_t size, void (*enter_critical)(void), void (*exit_critical)(void))
+{
+    uintptr_t addr = (uintptr_t)buffer;
+    uintptr_t aligned_addr = (addr + sizeof(void *) - 1) & ~(sizeof(void *) - 1);
+    uint32_t offset = (aligned_addr - addr) + ((sizeof(HeapManager) + sizeof(void *) - 1) & ~(sizeof(void *) - 1));
+    if (buffer == NULL || size < offset + sizeof(HeapBlockList) + HEAP_MIN_BLOCK_SIZE)
+    {
+        HEAP_MANAGER_ERROR("heap_mgr_create buffer is too small, size = %d\n", size);
+        return NULL;
+    }
+    HeapManager *heap = (HeapManager *)aligned_addr;
+    __heap_mgr_setup(heap, buffer + offset, size - offset, enter_critical, exit_critical);
+    HEAP_MANAGER_INFO("HeapManager create successfully adress:%p ,size : %d KB\n", heap->heapTop, size / 1024);
+    return heap;
+}
+/**
+ * @brief  Disable a heap created by heap_mgr_create, the buffer belongs to the caller again
+ *         Allocations from the heap fail and frees are refused afterwards, mapped blocks and segments are unmapped
+ * @param  heap
+ * @retval void
+ */
+void heap_mgr_destroy(HeapManager *heap)
+{
+    if (heap != NULL && heap != &__heapMgr)
+    {
+        __enter_critical(heap);
+#if (HEAP_MANAGER_USE_MMAP == 1)
+        __heap_mmap_release(heap);
+#endif
+        heap->isEnable = false;
+        __exit_critical(heap);
+    }
+}
+/**
+ * @brief  Get the default heap used by heap_mgr_malloc/heap_mgr_free
+ * @param  void
+ * @retval Heap handle
+ */
+HeapManager *heap_mgr_getDefault(void)
+{
+    return &__heapMgr;
+}
+/**
+ * @brief  Check if the heap manager is already been initilized
+ * @param  void
+ * @retval true if heap manager is initilized
+ */
+bool heap_mgr_isInitilized()
+{
+    return __heapMgr.isEnable;
+}
+/**
+ * @brief  Allocate memory from a heap
+ * @param  heap: Heap handle
+ * @param  size: Size
+ * @retval Pointer to the allocated memory
+ */
+void *heap_mgr_malloc_from(HeapManager *heap, uint32_t size)
+{
+    void *p = NULL;
+#if (HEAP_MANAGER_USE_MMAP == 1)
+    if (size >= HEAP_MMAP_THRESHOLD)
+    {
+        return __heap_mmap_malloc(heap, size);
+    }
+#endif
+    __enter_critical(heap);
+    p = __internal_malloc(heap, size);
+#if (HEAP_MANAGER_USE_MMAP == 1)
+    if (p == NULL && size != 0)
+    {
+        p = __heap_segment_malloc(heap, size);
+    }
+#endif
+    __exit_critical(heap);
+    return p;
+}
+/**
+ * @brief  Allocate memory and initialize
+ * @param  size: Size
+ * @retval Pointer to the allocated memory
+ */
+void *heap_mgr_malloc(uint32_t size)
+{
+#if (HEAP_MANAGER_USE_THREAD_CACHE == 1)
+    if (size != 0 && size <= (16u << (HEAP_THREAD_CACHE_CLASS_NUM - 1)))
+    {
+        uint8_t index = 0;
+        while ((16u << index) < size)
+        {
+            index++;
+        }
+        void *p = __heap_cache_malloc(index);
+#if (HEAP_MANAGER_USE_MMAP == 1)
+        if (p == NULL)
+        {
+            p = heap_mgr_malloc_from(&__heapMgr, size); // the cache only refills from the heap buffer
+        }
+#endif
+        return p;
+    }
+#endif
+    return heap_mgr_malloc_from(&__heapMgr, size);
+}
+/**
+ * @brief  Free memory allocated from a heap
+ * @param  heap: Heap handle
+ * @param  ptr
+ * @retval void
+ */
+void heap_mgr_free_from(HeapManager *heap, void *ptr)
+{
+    __enter_critical(heap);
+#if (HEAP_MANAGER_USE_MMAP == 1)
+    if (ptr != NULL && (ptr < heap->heapTop || ptr >= heap->heapEnd) && __heap_mmap_free(heap, ptr))
+    {
+        __exit_critical(heap);
+        return;
+    }
+#endif
+    __internal_free(heap, ptr);
+    __exit_critical(heap);
+}
+/**
+ * @brief  Free the allocated memory
+ * @retval void
+ */
+void heap_mgr_free(void *ptr)
+{
+#if (HEAP_MANAGER_USE_THREAD_CACHE == 1)
+    if (ptr != NULL && __heap_cache_free(ptr))
+    {
+        return;
+    }
+#endif
+    heap_mgr_free_from(&__heapMgr, ptr);
+}
+#if (HEAP_MANAGER_USE_THREAD_CACHE == 1)
+/**
+ * @brief  Give all blocks cached by the calling thread back to the heap
+ * @retval void
+ */
+void heap_mgr_flushThreadCache(void)
+{
+    __heap_cache_destructor(&__threadCache);
+}
+#endif
+/**
+ * @brief  Reallocate memory from a heap
+ * @param  heap: Heap handle
+ * @param  ptr: Allocated memory address
+ * @param  new_size: new size of the memory
+ * @retval Pointer to the allocated memory
+ */
+void *heap_mgr_realloc_from(HeapManager *heap, void *ptr, uint32_t new_size)
+{
+#if (HEAP_MANAGER_USE_MMAP == 1)
+    if (ptr != NULL && new_size != 0 && (ptr < heap->heapTop || ptr >= heap->heapEnd || new_size >= HEAP_MMAP_THRESHOLD))
+    {
+        return __heap_mmap_realloc(heap, ptr, new_size);
+    }
+    if (ptr == NULL)
+    {
+        return heap_mgr_malloc_from(heap, new_size);
+    }
+#endif
+    __enter_critical(heap);
+    void *_ptr = __internal_heap_mgr_realloc(heap, ptr, new_size);
+    __exit_critical(heap);
+#if (HEAP_MANAGER_USE_MMAP == 1)
+    if (_ptr == NULL && new_size != 0)
+    {
+        _ptr = __heap_mmap_realloc(heap, ptr, new_size); // the heap buffer is full, move to a segment
+        if (_ptr != NULL)
+        {
+            __enter_critical(heap);
+            heap->failedCount--; // counted by the in-place attempt
+            __exit_critical(heap);
+        }
+    }
+#endif
+    return _ptr;
+}
+/**
+ * @brief  Reallocate memory
+ * @param  addrToPtr: Allocated memory address
+ * @param  size: new size of the memory
+ * @retval Pointer to the allocated memory
+ */
+void *heap_mgr_realloc(void *ptr, uint32_t new_size)
+{
+    return heap_mgr_realloc_from(&__heapMgr, ptr, new_size);
+}
+/**
+ * @brief  Allocate aligned memory from a heap
+ * @param  heap: Heap handle
+ * @param  align: Alignment, power of 2
+ * @param  size: Size
+ * @retval Pointer to the allocated memory, free it with heap_mgr_free_from
+ */
+void *heap_mgr_aligned_alloc_from(HeapManager *heap, uint32_t align, uint32_t size)
+{
+    __enter_critical(heap);
+    void *p = __internal_aligned_malloc(heap, align, size);
+    __exit_critical(heap);
+    return p;
+}
+/**
+ * @brief  Allocate aligned memory
+ * @param  align: Alignment, power of 2
+ * @param  size: Size
+ * @retval Pointer to the allocated memory, free it with heap_mgr_free
+ */
+void *heap_mgr_aligned_alloc(uint32_t align, uint32_t size)
+{
+    return heap_mgr_aligned_alloc_from(&__heapMgr, align, size);
+}
+#if (HEAP_MANAGER_USE_ZERO_TRACK == 1)
+/**
+ * @brief  Take the zero bit of a block just allocated, called with the heap locked
+ *         A known-zero block only has the free block metadata left to clear
+ * @param  ptr: NULL is ignored
+ * @retval true if the payload is zero now
+ */
+static bool __heap_mgr_takeZero(void *ptr)
+{
+    if (ptr == NULL)
+    {
+        return false;
+    }
+    HeapBlockList *node = (HeapBlockList *)((uint8_t *)ptr - sizeof(HeapBlockList));
+    if (!node->isZero)
+    {
+        return false;
+    }
+    node->isZero = 0;
+    memset(ptr, 0, HEAP_FREE_META_HEAD);
+    memset((uint8_t *)ptr + node->size - HEAP_FOOTER_SIZE, 0, HEAP_FOOTER_SIZE);
+    return true;
+}
+#endif
+/**
+ * @brief  Allocate memory from a heap and initialize to zero (calloc)
+ *         Blocks known to be zero are not cleared again
+ * @param  heap: Heap handle
+ * @param  nmemb: Number of elements
+ * @param  size: Size of each element
+ * @retval Pointer to the allocated memory
+ */
+void *heap_mgr_calloc_from(HeapManager *heap, uint32_t nmemb, uint32_t size)
+{
+    if (nmemb && size > (0xFFFFFFFF / nmemb))
+    {
+        return NULL;
+    }
+    uint32_t total_size = nmemb * size;
+#if (HEAP_MANAGER_USE_ZERO_TRACK == 1)
+#if (HEAP_MANAGER_USE_MMAP == 1)
+    if (total_size >= HEAP_MMAP_THRESHOLD)
+    {
+        return __heap_mmap_malloc(heap, total_size); // fresh pages are zero
+    }
+#endif
+    __enter_critical(heap);
+    void *ptr = __internal_malloc(heap, total_size);
+#if (HEAP_MANAGER_USE_MMAP == 1)
+    if (ptr == NULL && total_size != 0)
+    {
+        ptr = __heap_segment_malloc(heap, total_size);
+    }
+#endif
+    bool zero = __heap_mgr_takeZero(ptr);
+    __exit_critical(heap);
+    if (ptr != NULL && !zero)
+    {
+        memset(ptr, 0, total_size);
+    }
+#else
+    void *ptr = heap_mgr_malloc_from(heap, total_size);
+    if (ptr != NULL)
+    {
+        memset(ptr, 0, total_size);
+    }
+#endif
+    return ptr;
+}
+/**
+ * @brief  Allocate memory and initialize to zero (calloc)
+ * @param  nmemb: Number of elements
+ * @param  size: Size of each element
+ * @retval Pointer to the allocated memory
+ */
+void *heap_mgr_calloc(uint32_t nmemb, uint32_t size)
+{
+#if (HEAP_MANAGER_USE_THREAD_CACHE == 1)
+    if (nmemb && size > (0xFFFFFFFF / nmemb))
+    {
+        return NULL;
+    }
+    uint32_t total_size = nmemb * size;
+    if (total_size != 0 && total_size <= (16u << (HEAP_THREAD_CACHE_CLASS_NUM - 1)))
+    {
+        void *ptr = heap_mgr_malloc(total_size); // cached blocks are never known-zero
+        if (ptr != NULL)
+        {
+            memset(ptr, 0, total_size);
+        }
+        return ptr;
+    }
+#endif
+    return heap_mgr_calloc_from(&__heapMgr, nmemb, size);
+}
+/**
+ * @brief  Allocate aligned memory from a heap and initialize to zero
+ * @param  heap: Heap handle
+ * @param  align: Alignment, power of 2
+ * @param  size: Size
+ * @retval Pointer to the allocated memory, free it with heap_mgr_free_from
+ */
+void *heap_mgr_aligned_calloc_from(HeapManager *heap, uint32_t align, uint32_t size)
+{
+    __enter_critical(heap);
+    void *ptr = __internal_aligned_malloc(heap, align, size);
+#if (HEAP_MANAGER_USE_ZERO_TRACK == 1)
+    bool zero = __heap_mgr_takeZero(ptr);
+#else
+    bool zero = false;
+#endif
+    __exit_critical(heap);
+    if (ptr != NULL && !zero)
+    {
+        memset(ptr, 0, size);
+    }
+    return ptr;
+}
+/**
+ * @brief  Allocate aligned memory and initialize to zero
+ * @param  align: Alignment, power of 2
+ * @param  size: Size
+ * @retval Pointer to the allocated memory, free it with heap_mgr_free
+ */
+void *heap_mgr_aligned_calloc(uint32_t align, uint32_t size)
+{
+    return heap_mgr_aligned_calloc_from(&__heapMgr, align, size);
+}
+/**
+ * @brief  Get the statistics of a heap, O(1) (counters are kept up to date by malloc/free),
+ *         never walks the blocks
+ * @param  heap: Heap handle
+ * @param  stats: Output
+ * @retval void
+ */
+void heap_mgr_getStats_from(HeapManager *heap, HeapStats *stats)
+{
+    __enter_critical(heap);
+#if (HEAP_MANAGER_USE_TLSF == 1)
+    uint32_t largest = __heap_tlsf_getMaxFreeBlockSize(heap);
+#else
+    uint32_t largest = heap->maxFreeBlock; // exact, realloc refreshes it when it takes the largest block
+#endif
+    stats->totalSize = heap->heapTotalSize;
+    stats->usedBytes = heap->heapTotalSize - heap->blockNum * sizeof(HeapBlockList) - heap->freeBytes;
+    stats->peakUsedBytes = heap->peakUsedBytes;
+    stats->freeBytes = heap->freeBytes;
+    stats->blockNum = heap->blockNum;
+    stats->freeBlockNum = heap->freeBlockNum;
+    stats->largestFreeBlock = largest;
+    stats->mallocCount = heap->mallocCount;
+    stats->freeCount = heap->freeCount;
+    stats->failedCount = heap->failedCount;
+    stats->invalidFreeCount = heap->invalidFreeCount;
+#if (HEAP_MANAGER_USE_MMAP == 1)
+    stats->mappedBytes = heap->mappedBytes;
+#else
+    stats->mappedBytes = 0;
+#endif
+    stats->fragmentation = heap->freeBytes ? (uint8_t)(100 - (uint64_t)largest * 100 / heap->freeBytes) : 0;
+    __exit_critical(heap);
+}
+/**
+ * @brief  Get the statistics of the heap
+ * @param  stats: Output
+ * @retval void
+ */
+void heap_mgr_getStats(HeapStats *stats)
+{
+    heap_mgr_getStats_from(&__heapMgr, stats);
+}
+/**
+ * @brief  Get Heap block Pool Infor
+ * @param  NONE
+ * @retval size
+ */
+void heap_mgr_logHeapPool(void)
+{
+    __heap_mgr_logHeapPool(&__heapMgr);
+}
+/**
+ * @brief  Get the block, O(1) with HEAP_MANAGER_USE_BLOCK_CHECK
+ * @param  ptr block address
+ * @retval block infor
+ */
+HeapBlockList *heap_mgr_getHeapBlock(void *ptr)
+{
+#if (HEAP_MANAGER_USE_BLOCK_CHECK == 1)
+    if (__heap_mgr_matchMagic(&__heapMgr, ptr, HEAP_BLOCK_MAGIC_USED) ||
+        __heap_mgr_matchMagic(&__heapMgr, ptr, HEAP_BLOCK_MAGIC_FREE)
+#if (HEAP_MANAGER_USE_THREAD_CACHE == 1)
+        || __heap_mgr_matchMagic(&__heapMgr, ptr, HEAP_BLOCK_MAGIC_CACHED)
+#endif
+    )
+    {
+        return (HeapBlockList *)((uint8_t *)ptr - sizeof(HeapBlockList));
+    }
+    return NULL;
+#else
+    if ((ptr < __heapMgr.heapTop) || (ptr > __heapMgr.heapEnd))
+    {
+        return NULL; // Adress no valid
+    }
+    HeapBlockList *node = __heapMgr.head;
+    uint8_t *current_p = NULL;
+    while (node)
+    {
+        uint32_t current_size = node->size;
+        current_p = (uint8_t *)node + sizeof(HeapBlockList);
+        if ((ptr == current_p) && (ptr < (current_p + current_size)))
+        {
+            return node;
+        }
+        node = __heap_mgr_nextBlock(&__heapMgr, node);
+    }
+    return NULL;
+#endif
+}
+/**
+ * @brief  Take one chunk from a heap for an arena
+ * @param  arena: Output
+ * @param  heap: Heap handle
+ * @param  size: Capacity of the arena
+ * @retval true if success
+ */
+bool heap_mgr_arena_init(heap_mgr_arena_t *arena, HeapManager *heap, uint32_t size)
+{
+    arena->heap = heap;
+    arena->offset = 0;
+    arena->size = __heap_mgr_alignSize(size);
+    arena->base = (uint8_t *)heap_mgr_malloc_from(heap, arena->size);
+    if (arena->base == NULL)
+    {
+        arena->size = 0;
+        return false;
+    }
+    return true;
+}
+/**
+ * @brief  Bump allocate from an arena
+ * @param  arena
+ * @param  size
+ * @retval Adress aligned to sizeof(void *), NULL if the arena is full
+ */
+void *heap_mgr_arena_malloc(heap_mgr_arena_t *arena, uint32_t size)
+{
+    // arena size and offset are multiples of sizeof(void *), rounding size up stays inside
+    if (size == 0 || size > arena->size - arena->offset)
+    {
+        return NULL;
+    }
+    void *p = arena->base + arena->offset;
+    arena->offset += (size + sizeof(void *) - 1) & ~(uint32_t)(sizeof(void *) - 1);
+    return p;
+}
+/**
+ * @brief  Free everything allocated from an arena, the chunk is kept
+ * @param  arena
+ * @retval void
+ */
+void heap_mgr_arena_reset(heap_mgr_arena_t *arena)
+{
+    arena->offset = 0;
+}
+/**
+ * @brief  Give the chunk of an arena back to its heap
+ * @param  arena
+ * @retval void
+ */
+void heap_mgr_arena_destroy(heap_mgr_arena_t *arena)
+{
+    if (arena->base != NULL)
+    {
+        heap_mgr_free_from(arena->heap, arena->base);
+    }
+    arena->base = NULL;
+    arena->size = 0;
+    arena->offset = 0;
+}
+#if (HEAP_MANAGER_USE_HANDLE == 1)
+/* A relocatable block starts with the index of its handle, the user data follows it */
+#define HEAP_HANDLE_PREFIX_SIZE sizeof(void *)
+
+static uint32_t (*__heap_mgr_micros)(void) = NULL;
+
+/**
+ * @brief  Get the handle entry of a block if it can be moved
+ * @param  heap
+ * @param  node: used block
+ * @retval Handle entry, NULL if node is not relocatable or is pinned
+ */
+static HeapHandleEntry *__heap_handle_getMovable(HeapManager *heap, HeapBlockList *node)
+{
+    // Any block payload holds at least a pointer, the table entry confirms the index
+    uintptr_t index = *(uintptr_t *)((uint8_t *)node + sizeof(HeapBlockList));
+    if (index >= HEAP_HANDLE_NUM || heap->handles[index].block != node || heap->handles[index].lockCount != 0)
+    {
+        return NULL;
+    }
+    return &heap->handles[index];
+}
+/**
+ * @brief  Get the entry of a handle
+ * @param  heap
+ * @param  handle
+ * @retval Handle entry, NULL if the handle is invalid or stale
+ */
+static HeapHandleEntry *__heap_handle_getEntry(HeapManager *heap, HeapHandle handle)
+{
+    uint32_t index = (handle & 0xFFFF) - 1u; // handle 0 wraps to an out of range index
+    if (!heap->isEnable || index >= HEAP_HANDLE_NUM)
+    {
+        return NULL;
+    }
+    HeapHandleEntry *entry = &heap->handles[index];
+    if (entry->block == NULL || entry->generation != (uint16_t)(handle >> 16))
+    {
+        return NULL;
+    }
+    return entry;
+}
+/**
+ * @brief  Move a used block down to the start of the free block in front of it
+ *         free | used | next  ->  used | free (+ next if it is free)
+ * @param  heap
+ * @param  node: free block
+ * @param  used: relocatable block following node
+ * @param  entry: handle entry of used
+ * @retval The free block behind the moved block
+ */
+static HeapBlockList *__heap_handle_slide(HeapManager *heap, HeapBlockList *node, HeapBlockList *used, HeapHandleEntry *entry)
+{
+    uint32_t freeSize = node->size;
+    HeapBlockList *next = __heap_mgr_nextBlock(heap, used);
+#if (HEAP_MANAGER_BLOCK_LAYOUT == HEAP_BLOCK_LAYOUT_LIST)
+    HeapBlockList *prev = node->prev;
+#endif
+    __heap_mgr_removeFree(heap, node);
+    // The header of used may be overwritten by the move
+    HeapBlockList header = *used;
+    memmove((uint8_t *)node + sizeof(HeapBlockList), (uint8_t *)used + sizeof(HeapBlockList), header.size);
+
+    HeapBlockList *moved = node;
+    *moved = header;
+    HeapBlockList *gap = (HeapBlockList *)((uint8_t *)moved + sizeof(HeapBlockList) + header.size);
+    gap->info = 0;
+    gap->size = freeSize;
+#if (HEAP_MANAGER_BLOCK_LAYOUT == HEAP_BLOCK_LAYOUT_BOUNDARY_TAG)
+    moved->isPrevFree = 0; // the block in front of a free block is never free
+#else
+    moved->prev = prev;
+    moved->next = gap;
+    gap->prev = moved;
+    gap->next = next;
+    if (next != NULL)
+    {
+        next->prev = gap;
+    }
+#endif
+    __heap_mgr_setOccupied(heap, moved, true);
+    __heap_mgr_setOccupied(heap, gap, false);
+    entry->block = moved;
+    if (next != NULL && next->isOccupied == 0)
+    {
+        __heap_mgr_removeFree(heap, next);
+        __heap_mgr_mergeNext(heap, gap, next);
+        __heap_mgr_setOccupied(heap, gap, false);
+    }
+    __heap_mgr_insertFree(heap, gap);
+    return gap;
+}
+/**
+ * @brief  Allocate a relocatable block from a heap
+ * @param  heap: Heap handle
+ * @param  size
+ * @retval Handle, 0 if failed
+ */
+HeapHandle heap_mgr_halloc_from(HeapManager *heap, uint32_t size)
+{
+    HeapHandle handle = 0;
+    __enter_critical(heap);
+    for (uint16_t i = 0; i < HEAP_HANDLE_NUM; i++)
+    {
+        if (heap->handles[i].block == NULL)
+        {
+            uint8_t *p = (uint8_t *)__internal_malloc(heap, size + HEAP_HANDLE_PREFIX_SIZE);
+            if (p != NULL)
+            {
+                *(uintptr_t *)p = i;
+                heap->handles[i].block = (HeapBlockList *)(p - sizeof(HeapBlockList));
+                heap->handles[i].lockCount = 0;
+                handle = ((HeapHandle)heap->handles[i].generation << 16) | (i + 1u);
+            }
+            break;
+        }
+    }
+    __exit_critical(heap);
+    return handle;
+}
+/**
+ * @brief  Free a relocatable block of a heap, refused while the block is locked
+ * @param  heap: Heap handle
+ * @param  handle
+ * @retval void
+ */
+void heap_mgr_hfree_from(HeapManager *heap, HeapHandle handle)
+{
+    __enter_critical(heap);
+    HeapHandleEntry *entry = __heap_handle_getEntry(heap, handle);
+    if (entry != NULL && entry->lockCount != 0)
+    {
+        // The address from heap_mgr_hlock would dangle
+        heap->invalidFreeCount++;
+        HEAP_MANAGER_ERROR("hfree handle %u refused, the block is locked\n", (unsigned)handle);
+    }
+    else if (entry != NULL)
+    {
+        __internal_free(heap, (uint8_t *)entry->block + sizeof(HeapBlockList));
+        entry->block = NULL;
+        entry->generation++;
+    }
+    else if (handle != 0)
+    {
+        heap->invalidFreeCount++;
+        HEAP_MANAGER_ERROR("hfree invalid handle %u (double free or stale)\n", (unsigned)handle);
+    }
+    __exit_critical(heap);
+}
+/**
+ * @brief  Pin a relocatable block of a heap
+ * @param  heap: Heap handle
+ * @param  handle
+ * @retval Address of the block, NULL if the handle is invalid
+ */
+void *heap_mgr_hlock_from(HeapManager *heap, HeapHandle handle)
+{
+    void *p = NULL;
+    __enter_critical(heap);
+    HeapHandleEntry *entry = __heap_handle_getEntry(heap, handle);
+    if (entry != NULL && entry->lockCount != UINT16_MAX)
+    {
+        entry->lockCount++;
+        p = (uint8_t *)entry->block + sizeof(HeapBlockList) + HEAP_HANDLE_PREFIX_SIZE;
+    }
+    __exit_critical(heap);
+    return p;
+}
+/**
+ * @brief  Unpin a relocatable block of a heap
+ * @param  heap: Heap handle
+ * @param  handle
+ * @retval void
+ */
+void heap_mgr_hunlock_from(HeapManager *heap, HeapHandle handle)
+{
+    __enter_critical(heap);
+    HeapHandleEntry *entry = __heap_handle_getEntry(heap, handle);
+    if (entry != NULL && entry->lockCount != 0 && --entry->lockCount == 0)
+    {
+        // The free block in front of it was skipped while the block was pinned
+        HeapBlockList *prev = __heap_mgr_prevFreeBlock(entry->block);
+        if (prev != NULL)
+        {
+            __heap_handle_rewind(heap, prev);
+        }
+    }
+    __exit_critical(heap);
+}
+/**
+ * @brief  Slide unpinned relocatable blocks of a heap down over free blocks, resuming where
+ *         the previous call stopped. The budget is checked every HEAP_COMPACT_CHECK_BLOCKS blocks
+ *         and after every move
+ * @param  heap: Heap handle
+ * @param  budgetUs: Time budget, one block moved or HEAP_COMPACT_CHECK_BLOCKS walked if no clock is set
+ * @retval Bytes moved
+ */
+uint32_t heap_mgr_compact_from(HeapManager *heap, uint32_t budgetUs)
+{
+    uint32_t movedBytes = 0;
+    uint32_t walked = 0;
+    uint32_t start = __heap_mgr_micros ? __heap_mgr_micros() : 0;
+    __enter_critical(heap);
+    HeapBlockList *node = heap->isEnable ? heap->compactCursor : (HeapBlockList *)heap->heapEnd;
+    while ((void *)node < heap->heapEnd)
+    {
+        HeapBlockList *next = __heap_mgr_nextBlock(heap, node);
+        HeapHandleEntry *entry = NULL;
+        bool moved = false;
+        if (node->isOccupied == 0 && next != NULL && next->isOccupied == 1 &&
+            (entry = __heap_handle_getMovable(heap, next)) != NULL)
+        {
+            movedBytes += next->size;
+            next = __heap_handle_slide(heap, node, next, entry);
+            moved = true;
+        }
+        node = (next != NULL) ? next : (HeapBlockList *)heap->heapEnd;
+        if (moved || ++walked % HEAP_COMPACT_CHECK_BLOCKS == 0)
+        {
+            if (__heap_mgr_micros == NULL || __heap_mgr_micros() - start >= budgetUs)
+            {
+                break;
+            }
+        }
+    }
+    // The blocks in front of node are compact until a free or an unpin rewinds the cursor
+    heap->compactCursor = node;
+    __exit_critical(heap);
+    return movedBytes;
+}
+/**
+ * @brief  Check if heap_mgr_compact_from has nothing left to move
+ * @param  heap: Heap handle
+ * @retval true if the walk reached the end of the heap since the last change
+ */
+bool heap_mgr_isCompacted_from(HeapManager *heap)
+{
+    __enter_critical(heap);
+    bool done = (void *)heap->compactCursor >= heap->heapEnd;
+    __exit_critical(heap);
+    return done;
+}
+/**
+ * @brief  Allocate a relocatable block
+ * @param  size
+ * @retval Handle, 0 if failed
+ */
+HeapHandle heap_mgr_halloc(uint32_t size)
+{
+    return heap_mgr_halloc_from(&__heapMgr, size);
+}
+/**
+ * @brief  Free a relocatable block
+ * @param  handle
+ * @retval void
+ */
+void heap_mgr_hfree(HeapHandle handle)
+{
+    heap_mgr_hfree_from(&__heapMgr, handle);
+}
+/**
+ * @brief  Pin a relocatable block
+ * @param  handle
+ * @retval Address of the block, NULL if the handle is invalid
+ */
+void *heap_mgr_hlock(HeapHandle handle)
+{
+    return heap_mgr_hlock_from(&__heapMgr, handle);
+}
+/**
+ * @brief  Unpin a relocatable block
+ * @param  handle
+ * @retval void
+ */
+void heap_mgr_hunlock(HeapHandle handle)
+{
+    heap_mgr_hunlock_from(&__heapMgr, handle);
+}
+/**
+ * @brief  Slide unpinned relocatable blocks down over free blocks, resuming where the previous call stopped
+ * @param  budgetUs: Time budget
+ * @retval Bytes moved
+ */
+uint32_t heap_mgr_compact(uint32_t budgetUs)
+{
+    return heap_mgr_compact_from(&__heapMgr, budgetUs);
+}
+/**
+ * @brief  Check if heap_mgr_compact has nothing left to move
+ * @param  void
+ * @retval true if the walk reached the end of the heap since the last change
+ */
+bool heap_mgr_isCompacted(void)
+{
+    return heap_mgr_isCompacted_from(&__heapMgr);
+}
+/**
+ * @brief  Set the microsecond clock used for the compaction budget
+ * @param  micros
+ * @retval void
+ */
+void heap_mgr_setClock(uint32_t (*micros)(void))
+{
+    __heap_mgr_micros = micros;
+}
+/**
+ * @brief  Background compaction step, fits TaskFunction_t of MillisTaskManager
+ * @param  param: Heap handle, NULL for the default heap
+ * @retval void
+ */
+void heap_mgr_compactTask(void *param)
+{
+    heap_mgr_compact_from(param != NULL ? (HeapManager *)param : &__heapMgr, HEAP_COMPACT_TASK_BUDGET_US);
+}
+#endif
+#if (HEAP_MANAGER_USE_POOL == 1)
+/**
+ * @brief  Get the pool class of a size
+ * @param  size
+ * @retval class index, HEAP_POOL_CLASS_NUM if too large
+ */
+static uint8_t __heap_pool_classIndex(uint32_t size)
+{
+    uint8_t index = 0;
+    while (index < HEAP_POOL_CLASS_NUM && size > (8u << index))
+    {
+        index++;
+    }
+    return index;
+}
+/* Offset of the first object in a slab */
+#define HEAP_POOL_SLAB_HEAD ((sizeof(HeapPoolSlab) + sizeof(void *) - 1) & ~(uint32_t)(sizeof(void *) - 1))
+
+#if (HEAP_MANAGER_USE_BLOCK_CHECK == 1)
+/**
+ * @brief  Find the slab of a class holding an object, walks the slabs of the class
+ * @param  poolClass
+ * @param  ptr
+ * @param  objSize
+ * @param  objIndex: Output, index of the object in the slab
+ * @retval Slab, NULL if ptr is not the start of an object of the class
+ */
+static HeapPoolSlab *__heap_pool_findSlab(HeapPoolClass *poolClass, void *ptr, uint32_t objSize, uint32_t *objIndex)
+{
+    for (HeapPoolSlab *slab = poolClass->slabs; slab != NULL; slab = slab->next)
+    {
+        uint8_t *first = (uint8_t *)slab + HEAP_POOL_SLAB_HEAD;
+        if ((uint8_t *)ptr < first || (uint8_t *)ptr >= (uint8_t *)slab + HEAP_POOL_SLAB_SIZE)
+        {
+            continue;
+        }
+        uint32_t offset = (uint32_t)((uint8_t *)ptr - first);
+        *objIndex = offset / objSize;
+        return (offset % objSize == 0 && HEAP_POOL_SLAB_HEAD + offset + objSize <= HEAP_POOL_SLAB_SIZE) ? slab : NULL;
+    }
+    return NULL;
+}
+#endif
+/**
+ * @brief  Carve a new slab from the heap for a class
+ * @param  heap
+ * @param  poolClass
+ * @param  objSize
+ * @retval true if success
+ */
+static bool __heap_pool_grow(HeapManager *heap, HeapPoolClass *poolClass, uint32_t objSize)
+{
+    uint8_t *slab = (uint8_t *)__internal_malloc(heap, HEAP_POOL_SLAB_SIZE);
+    if (slab == NULL)
+    {
+        return false;
+    }
+    ((HeapPoolSlab *)slab)->next = poolClass->slabs;
+#if (HEAP_MANAGER_USE_BLOCK_CHECK == 1)
+    memset(((HeapPoolSlab *)slab)->usedMap, 0, sizeof(((HeapPoolSlab *)slab)->usedMap));
+#endif
+    poolClass->slabs = (HeapPoolSlab *)slab;
+    poolClass->slabNum++;
+    uint32_t offset = HEAP_POOL_SLAB_HEAD;
+    while (offset + objSize <= HEAP_POOL_SLAB_SIZE)
+    {
+        void **obj = (void **)(slab + offset);
+        *obj = poolClass->freeList;
+        poolClass->freeList = obj;
+        poolClass->capacity++;
+        offset += objSize;
+    }
+    return true;
+}
+/**
+ * @brief  Allocate a small object from the slab pools of a heap
+ * @param  heap: Heap handle
+ * @param  size: Size, requests larger than 64 bytes fall back to heap_mgr_malloc_from
+ * @retval Pointer to the allocated memory
+ */
+void *heap_mgr_pool_malloc_from(HeapManager *heap, uint32_t size)
+{
+    uint8_t index = __heap_pool_classIndex(size);
+    if (size == 0 || index >= HEAP_POOL_CLASS_NUM)
+    {
+        return heap_mgr_malloc_from(heap, size);
+    }
+    HeapPoolClass *poolClass = &heap->pool[index];
+    void **obj = NULL;
+    __enter_critical(heap);
+    if (heap->isEnable && (poolClass->freeList != NULL || __heap_pool_grow(heap, poolClass, 8u << index)))
+    {
+        obj = (void **)poolClass->freeList;
+        poolClass->freeList = *obj;
+        poolClass->used++;
+#if (HEAP_MANAGER_USE_BLOCK_CHECK == 1)
+        uint32_t objIndex = 0;
+        HeapPoolSlab *slab = __heap_pool_findSlab(poolClass, obj, 8u << index, &objIndex);
+        slab->usedMap[objIndex / 32] |= 1u << (objIndex % 32);
+#endif
+        if (poolClass->used > poolClass->peak)
+        {
+            poolClass->peak = poolClass->used;
+        }
+    }
+    __exit_critical(heap);
+    return (void *)obj;
+}
+/**
+ * @brief  Allocate a small object from the slab pools
+ * @param  size: Size, requests larger than 64 bytes fall back to the heap
+ * @retval Pointer to the allocated memory
+ */
+void *heap_mgr_pool_malloc(uint32_t size)
+{
+    return heap_mgr_pool_malloc_from(&__heapMgr, size);
+}
+/**
+ * @brief  Give back an object allocated by heap_mgr_pool_malloc_from
+ *         Double frees and foreign pointers are refused and counted in invalidFreeCount
+ *         with HEAP_MANAGER_USE_BLOCK_CHECK, at the cost of a walk over the slabs of the class
+ * @param  heap: Heap handle
+ * @param  ptr: Object address
+ * @param  size: The size that was passed to heap_mgr_pool_malloc_from
+ * @retval void
+ */
+void heap_mgr_pool_free_from(HeapManager *heap, void *ptr, uint32_t size)
+{
+    if (ptr == NULL)
+        return;
+    uint8_t index = __heap_pool_classIndex(size);
+    if (size == 0 || index >= HEAP_POOL_CLASS_NUM)
+    {
+        heap_mgr_free_from(heap, ptr);
+        return;
+    }
+    HeapPoolClass *poolClass = &heap->pool[index];
+    __enter_critical(heap);
+    if (!heap->isEnable)
+    {
+        heap->invalidFreeCount++;
+        __exit_critical(heap);
+        HEAP_MANAGER_ERROR("pool free %p on a destroyed heap\n", ptr);
+        return;
+    }
+    bool valid = poolClass->used != 0;
+#if (HEAP_MANAGER_USE_BLOCK_CHECK == 1)
+    uint32_t objIndex = 0;
+    HeapPoolSlab *slab = valid ? __heap_pool_findSlab(poolClass, ptr, 8u << index, &objIndex) : NULL;
+    valid = slab != NULL && (slab->usedMap[objIndex / 32] & (1u << (objIndex % 32))) != 0;
+#endif
+    if (!valid)
+    {
+        heap->invalidFreeCount++;
+        __exit_critical(heap);
+        HEAP_MANAGER_ERROR("pool free invalid pointer %p (double free or not from this class)\n", ptr);
+        return;
+    }
+#if (HEAP_MANAGER_USE_BLOCK_CHECK == 1)
+    slab->usedMap[objIndex / 32] &= ~(1u << (objIndex % 32));
+#endif
+    *(void **)ptr = poolClass->freeList;
+    poolClass->freeList = ptr;
+    poolClass->used--;
+    __exit_critical(heap);
+}
+/**
+ * @brief  Give back an object allocated by heap_mgr_pool_malloc
+ * @param  ptr: Object address
+ * @param  size: The size that was passed to heap_mgr_pool_malloc
+ * @retval void
+ */
+void heap_mgr_pool_free(void *ptr, uint32_t size)
+{
+    heap_mgr_pool_free_from(&__heapMgr, ptr, size);
+}
+/**
+ * @brief  Get the occupancy of a pool class of a heap
+ * @param  heap: Heap handle
+ * @param  classIndex: 0 ~ HEAP_POOL_CLASS_NUM - 1
+ * @param  stats: Output
+ * @retval true if success
+ */
+bool heap_mgr_pool_getStats_from(HeapManager *heap, uint8_t classIndex, HeapPoolStats *stats)
+{
+    if (classIndex >= HEAP_POOL_CLASS_NUM || stats == NULL)
+    {
+        return false;
+    }
+    HeapPoolClass *poolClass = &heap->pool[classIndex];
+    __enter_critical(heap);
+    stats->objSize = 8u << classIndex;
+    stats->used = poolClass->used;
+    stats->capacity = poolClass->capacity;
+    stats->peak = poolClass->peak;
+    stats->slabNum = poolClass->slabNum;
+    __exit_critical(heap);
+    return true;
+}
+/**
+ * @brief  Get the occupancy of a pool class
+ * @param  classIndex: 0 ~ HEAP_POOL_CLASS_NUM - 1
+ * @param  stats: Output
+ * @retval true if success
+ */
+bool heap_mgr_pool_getStats(uint8_t classIndex, HeapPoolStats *stats)
+{
+    return heap_mgr_pool_getStats_from(&__heapMgr, classIndex, stats);
+}
+/**
+ * @brief  Printf the occupancy of all pool classes
+ * @retval void
+ */
+void heap_mgr_pool_logStats(void)
+{
+    HeapPoolStats stats;
+    for (uint8_t i = 0; i < HEAP_POOL_CLASS_NUM; i++)
+    {
+        heap_mgr_pool_getStats(i, &stats);
+        HEAP_MANAGER_INFO("pool[%d bytes] used = %d, capacity = %d, peak = %d, slabs = %d\n",
+                          stats.objSize, stats.used, stats.capacity, stats.peak, stats.slabNum);
+    }
+}
+#endif
+#if (HEAP_MANAGER_USE_PROFILE == 1)
+static const char __heap_profile_other[] = "other"; // sites that did not fit in the output
+/**
+ * @brief  Record the allocation site of a block of the default heap
+ * @param  ptr: can be NULL
+ * @param  file
+ * @param  line
+ * @retval ptr
+ */
+static void *__heap_mgr_tag(void *ptr, const char *file, uint32_t line)
+{
+    // Mapped blocks and segments have no block header here, they are not walked by the profile either
+    if (ptr != NULL && ptr >= __heapMgr.heapTop && ptr < __heapMgr.heapEnd)
+    {
+        __enter_critical(&__heapMgr); // heap_mgr_getProfile_from may be walking the blocks
+        __heap_mgr_setSite((HeapBlockList *)((uint8_t *)ptr - sizeof(HeapBlockList)), file, line);
+        __exit_critical(&__heapMgr);
+    }
+    return ptr;
+}
+/**
+ * @brief  heap_mgr_malloc recording the allocation site
+ * @param  size
+ * @param  file: NULL to record line as a user tag ID
+ * @param  line
+ * @retval Pointer to the allocated memory
+ */
+void *heap_mgr_malloc_tag(uint32_t size, const char *file, uint32_t line)
+{
+    return __heap_mgr_tag(heap_mgr_malloc(size), file, line);
+}
+/**
+ * @brief  heap_mgr_calloc recording the allocation site
+ */
+void *heap_mgr_calloc_tag(uint32_t nmemb, uint32_t size, const char *file, uint32_t line)
+{
+    return __heap_mgr_tag(heap_mgr_calloc(nmemb, size), file, line);
+}
+/**
+ * @brief  heap_mgr_realloc recording the allocation site
+ */
+void *heap_mgr_realloc_tag(void *ptr, uint32_t size, const char *file, uint32_t line)
+{
+    return __heap_mgr_tag(heap_mgr_realloc(ptr, size), file, line);
+}
+/**
+ * @brief  heap_mgr_aligned_alloc recording the allocation site
+ */
+void *heap_mgr_aligned_alloc_tag(uint32_t align, uint32_t size, const char *file, uint32_t line)
+{
+    return __heap_mgr_tag(heap_mgr_aligned_alloc(align, size), file, line);
+}
+/**
+ * @brief  heap_mgr_aligned_calloc recording the allocation site
+ */
+void *heap_mgr_aligned_calloc_tag(uint32_t align, uint32_t size, const char *file, uint32_t line)
+{
+    return __heap_mgr_tag(heap_mgr_aligned_calloc(align, size), file, line);
+}
+/**
+ * @brief  Aggregate the live blocks of a heap per allocation site in one pass
+ * @param  heap: Heap handle
+ * @param  sites: Output, sorted by bytes, largest first
+ * @param  num: Capacity of sites
+ * @retval Number of sites stored, when more than num - 1 sites are live the last one sums up the rest as "other"
+ */
+uint32_t heap_mgr_getProfile_from(HeapManager *heap, HeapProfileSite *sites, uint32_t num)
+{
+    uint32_t count = 0; // named sites, at most num - 1, the last entry is kept for "other"
+    uint32_t last = 0;
+    bool other = false;
+    if (num == 0 || !heap->isEnable)
+    {
+        return 0;
+    }
+    __enter_critical(heap);
+    for (HeapBlockList *node = heap->head; node != NULL; node = __heap_mgr_nextBlock(heap, node))
+    {
+        if (node->isOccupied == 0)
+        {
+            continue;
+        }
+        // Neighbouring blocks mostly come from the same site, try the last hit first
+        uint32_t i = last;
+        if (i >= count || sites[i].file != node->file || sites[i].line != node->line)
+        {
+            for (i = 0; i < count; i++)
+            {
+                if (sites[i].file == node->file && sites[i].line == node->line)
+                    break;
+            }
+            if (i == count && count < num - 1)
+            {
+                sites[i].file = node->file;
+                sites[i].line = node->line;
+                sites[i].blockNum = 0;
+                sites[i].bytes = 0;
+                count++;
+            }
+            else if (i == count)
+            {
+                i = num - 1;
+                if (!other)
+                {
+                    sites[i].file = __heap_profile_other;
+                    sites[i].line = 0;
+                    sites[i].blockNum = 0;
+                    sites[i].bytes = 0;
+                    other = true;
+                }
+            }
+            last = i;
+        }
+        sites[i].blockNum++;
+        sites[i].bytes += node->size;
+    }
+    __exit_critical(heap);
+    // Few sites, insertion sort is enough, "other" stays last
+    for (uint32_t i = 1; i < count; i++)
+    {
+        HeapProfileSite site = sites[i];
+        uint32_t j = i;
+        while (j > 0 && sites[j - 1].bytes < site.bytes)
+        {
+            sites[j] = sites[j - 1];
+            j--;
+        }
+        sites[j] = site;
+    }
+    return other ? num : count;
+}
+/**
+ * @brief  Printf live bytes per allocation site of the default heap, one CSV line per site
+ *         Plain printf without the log prefix, the snapshot does not depend on HEAP_MANAGER_USE_LOG
+ * @retval void
+ */
+void heap_mgr_dump_profile(void)
+{
+    static HeapProfileSite sites[HEAP_PROFILE_SITE_NUM];
+    uint32_t count = heap_mgr_getProfile_from(&__heapMgr, sites, HEAP_PROFILE_SITE_NUM);
+    printf("profile,site,line,blocks,bytes\n");
+    for (uint32_t i = 0; i < count; i++)
+    {
+        const char *file = sites[i].file;
+        if (file == NULL)
+        {
+            file = sites[i].line ? "tag" : "untagged";
+        }
+        printf("profile,%s,%u,%u,%u\n", file, (unsigned)sites[i].line,
+               (unsigned)sites[i].blockNum, (unsigned)sites[i].bytes);
+    }
+}
+#endif
@@ -10,6 +10,83 @@ extern "C"
 #define REDIRECT_NEW_DELETE_FUNC 1
 #define HEAP_DEBUG_CHECK 0
 
+/* Block layout */
+#define HEAP_BLOCK_LAYOUT_LIST 0         // prev/next/size header on every block
+#define HEAP_BLOCK_LAYOUT_BOUNDARY_TAG 1 // size/flag header, size footer on free blocks only
+#ifndef HEAP_MANAGER_BLOCK_LAYOUT
+#define HEAP_MANAGER_BLOCK_LAYOUT HEAP_BLOCK_LAYOUT_LIST
+#endif
+
+/* O(1) magic check on free/realloc: catches double frees and foreign pointers */
+#ifndef HEAP_MANAGER_USE_BLOCK_CHECK
+#define HEAP_MANAGER_USE_BLOCK_CHECK 1
+#endif
+
+/* Two-level segregated fit (TLSF) free index: O(1) malloc/free instead of best-fit list walks */
+#ifndef HEAP_MANAGER_USE_TLSF
+#define HEAP_MANAGER_USE_TLSF 0
+#endif
+/* log2 of the number of second-level lists per first-level size class */
+#ifndef HEAP_TLSF_SL_LOG2
+#define HEAP_TLSF_SL_LOG2 3
+#endif
+
+/* Slab pools serving 8/16/32/64 byte objects without block header */
+#ifndef HEAP_MANAGER_USE_POOL
+#define HEAP_MANAGER_USE_POOL 1
+#endif
+#define HEAP_POOL_CLASS_NUM 4 // object size of class n is (8 << n)
+#ifndef HEAP_POOL_SLAB_SIZE
+#define HEAP_POOL_SLAB_SIZE 512 // bytes taken from the heap each time a class runs empty
+#endif
+
+/* Per-thread magazines of small blocks in front of the heap lock (hosted builds, needs pthread) */
+#ifndef HEAP_MANAGER_USE_THREAD_CACHE
+#define HEAP_MANAGER_USE_THREAD_CACHE 0
+#endif
+#define HEAP_THREAD_CACHE_CLASS_NUM 5 // block size of class n is (16 << n)
+#define HEAP_THREAD_CACHE_DEPTH 32    // blocks kept per class and thread
+#define HEAP_THREAD_CACHE_BATCH 16    // blocks moved from/to the heap under one lock
+
+/* Record the allocation site in every block header, see heap_mgr_dump_profile */
+#ifndef HEAP_MANAGER_USE_PROFILE
+#define HEAP_MANAGER_USE_PROFILE 0
+#endif
+#define HEAP_PROFILE_SITE_NUM 32 // sites reported by heap_mgr_dump_profile
+
+/* Relocatable blocks behind handles, heap_mgr_compact slides them together */
+#ifndef HEAP_MANAGER_USE_HANDLE
+#define HEAP_MANAGER_USE_HANDLE 0
+#endif
+#ifndef HEAP_HANDLE_NUM
+#define HEAP_HANDLE_NUM 32 // handles per heap
+#endif
+#ifndef HEAP_COMPACT_TASK_BUDGET_US
+#define HEAP_COMPACT_TASK_BUDGET_US 200 // time budget of heap_mgr_compactTask
+#endif
+#ifndef HEAP_COMPACT_CHECK_BLOCKS
+#define HEAP_COMPACT_CHECK_BLOCKS 16 // blocks walked between two budget checks, per call without a clock
+#endif
+
+/* Hosted builds (needs mmap): large blocks are mapped directly, the heap grows by mapped segments */
+#ifndef HEAP_MANAGER_USE_MMAP
+#define HEAP_MANAGER_USE_MMAP 0
+#endif
+#ifndef HEAP_MMAP_THRESHOLD
+#define HEAP_MMAP_THRESHOLD (64 * 1024) // requests from this size on get their own mapping
+#endif
+#ifndef HEAP_MMAP_SEGMENT_SIZE
+#define HEAP_MMAP_SEGMENT_SIZE (256 * 1024) // size of a segment mapped when the heap is full
+#endif
+
+/* Remember which free blocks are known to be zero so calloc can skip the memset */
+#ifndef HEAP_MANAGER_USE_ZERO_TRACK
+#define HEAP_MANAGER_USE_ZERO_TRACK 1
+#endif
+#ifndef HEAP_ZERO_ON_FREE_SIZE
+#define HEAP_ZERO_ON_FREE_SIZE 0 // blocks up to this size are cleared on free, 0 : never
+#endif
+
 #define HEAP_MANAGER_USE_LOG 1
 
 #if (HEAP_MANAGER_USE_LOG == 1)
@@ -19,11 +96,44 @@ extern "C"
 #define HEAP_MANAGER_WARN(format, ...) _HEAP_MANAGER_LOG("[Warn] " format, ##__VA_ARGS__)
 #define HEAP_MANAGER_ERROR(format, ...) _HEAP_MANAGER_LOG("[Error] " format, ##__VA_ARGS__)
 #else
+#define _HEAP_MANAGER_LOG(...)
 #define HEAP_MANAGER_INFO(...)
 #define HEAP_MANAGER_INFO(...)
 #define HEAP_MANAGER_WARN(...)
 #define HEAP_MANAGER_ERROR(...)
 #endif
+#if (HEAP_MANAGER_BLOCK_LAYOUT == HEAP_BLOCK_LAYOUT_BOUNDARY_TAG)
+    /* Physical neighbours are found by address: next = header + size,
+     * prev = header - footer size when isPrevFree is set */
+    typedef struct _HeapBlockList
+    {
+        union
+        {
+            struct
+            {
+                union
+                {
+                    struct
+                    {
+                        uint32_t isOccupied : 1; // 0 : free 1 :used
+                        uint32_t isPrevFree : 1; // previous block is free and ends with a size footer
+                        uint32_t isZero : 1;     // free block whose payload is known to be zero
+                        uint32_t size : 29;      // size of the block
+                    };
+                    uint32_t info;
+                };
+#if (HEAP_MANAGER_USE_BLOCK_CHECK == 1)
+                uint32_t magic; // block address and state, fits in the padding on 64-bit
+#endif
+            };
+            void *align; // keep the payload aligned to sizeof(void *)
+        };
+#if (HEAP_MANAGER_USE_PROFILE == 1)
+        const char *file; // allocation site, NULL for a user tag
+        uint32_t line;    // line of the site or user tag ID, 0 if untagged
+#endif
+    } HeapBlockList;
+#else
     typedef struct _HeapBlockList
     {
         struct _HeapBlockList *prev;
@@ -33,12 +143,97 @@ extern "C"
             struct
             {
                 uint32_t isOccupied : 1; // 0 : free 1 :used
-                uint32_t size : 31;      // size of the block
+                uint32_t isZero : 1;     // free block whose payload is known to be zero
+                uint32_t size : 30;      // size of the block
             };
             uint32_t info;
         };
+#if (HEAP_MANAGER_USE_BLOCK_CHECK == 1)
+        uint32_t magic; // block address and state, fits in the padding on 64-bit
+#endif
+#if (HEAP_MANAGER_USE_PROFILE == 1)
+        const char *file; // allocation site, NULL for a user tag
+        uint32_t line;    // line of the site or user tag ID, 0 if untagged
+#endif
 
     } HeapBlockList;
+#endif
+#if (HEAP_MANAGER_USE_TLSF == 1)
+#if (UINTPTR_MAX > 0xFFFFFFFFu)
+#define HEAP_TLSF_ALIGN_LOG2 3
+#else
+#define HEAP_TLSF_ALIGN_LOG2 2
+#endif
+#define HEAP_TLSF_SL_COUNT (1u << HEAP_TLSF_SL_LOG2)
+#define HEAP_TLSF_FL_SHIFT (HEAP_TLSF_SL_LOG2 + HEAP_TLSF_ALIGN_LOG2)
+#define HEAP_TLSF_FL_COUNT (32 - HEAP_TLSF_FL_SHIFT + 1)
+    /* Free list links, stored in the payload of a free block */
+    typedef struct _HeapFreeLink
+    {
+        HeapBlockList *prevFree;
+        HeapBlockList *nextFree;
+    } HeapFreeLink;
+#endif
+#if (HEAP_MANAGER_USE_POOL == 1)
+    typedef struct _HeapPoolSlab
+    {
+        struct _HeapPoolSlab *next;
+#if (HEAP_MANAGER_USE_BLOCK_CHECK == 1)
+        uint32_t usedMap[(HEAP_POOL_SLAB_SIZE / 8 + 31) / 32]; // objects handed out, catches double frees
+#endif
+    } HeapPoolSlab;
+    typedef struct _HeapPoolClass
+    {
+        void *freeList;      // free objects, linked through their first word
+        HeapPoolSlab *slabs; // slabs owned by this class
+        uint32_t used;       // objects in use
+        uint32_t capacity;   // objects carved from the slabs
+        uint32_t peak;       // max objects in use
+        uint32_t slabNum;    // number of slabs
+    } HeapPoolClass;
+    typedef struct
+    {
+        uint32_t objSize;
+        uint32_t used;
+        uint32_t capacity;
+        uint32_t peak;
+        uint32_t slabNum;
+    } HeapPoolStats;
+#endif
+    typedef struct
+    {
+        uint32_t totalSize;        // size of the managed region
+        uint32_t usedBytes;        // payload bytes of used blocks
+        uint32_t peakUsedBytes;    // max of usedBytes
+        uint32_t freeBytes;        // payload bytes of free blocks
+        uint32_t blockNum;         // number of blocks
+        uint32_t freeBlockNum;     // number of free blocks
+        uint32_t largestFreeBlock; // largest request sure to succeed, TLSF: lower edge of the top list (< 1/HEAP_TLSF_SL_COUNT low)
+        uint32_t mallocCount;      // successful allocations
+        uint32_t freeCount;        // frees
+        uint32_t failedCount;      // failed allocations
+        uint32_t invalidFreeCount; // rejected frees (double free, foreign pointer)
+        uint32_t mappedBytes;      // bytes in mmap blocks and segments, not part of the other counters
+        uint8_t fragmentation;     // 0 ~ 100, 100 * (1 - largestFreeBlock / freeBytes)
+    } HeapStats;
+#if (HEAP_MANAGER_USE_HANDLE == 1)
+    typedef uint32_t HeapHandle; // entry index + 1 (low 16 bits) and generation (high 16 bits), 0 is invalid
+    typedef struct
+    {
+        HeapBlockList *block; // NULL if the entry is unused
+        uint16_t lockCount;   // the block is pinned while not 0
+        uint16_t generation;  // bumped when the block is freed, old handles stop resolving
+    } HeapHandleEntry;
+#endif
+#if (HEAP_MANAGER_USE_PROFILE == 1)
+    typedef struct
+    {
+        const char *file;  // NULL for a user tag
+        uint32_t line;     // line or user tag ID, file NULL and line 0 is untagged
+        uint32_t blockNum; // live blocks
+        uint32_t bytes;    // live payload bytes
+    } HeapProfileSite;
+#endif
     typedef struct _HeapManager
     {
         void *heapTop;
@@ -46,9 +241,47 @@ extern "C"
         uint32_t heapTotalSize;
         HeapBlockList *head;
         bool isEnable;
+#if (HEAP_MANAGER_USE_TLSF == 1)
+        uint32_t flBitmap;                                               // first level: non empty classes
+        uint32_t slBitmap[HEAP_TLSF_FL_COUNT];                           // second level: non empty lists
+        HeapBlockList *freeLists[HEAP_TLSF_FL_COUNT][HEAP_TLSF_SL_COUNT]; // free block lists
+#endif
+#if (HEAP_MANAGER_USE_POOL == 1)
+        HeapPoolClass pool[HEAP_POOL_CLASS_NUM];
+#endif
+#if (HEAP_MANAGER_USE_HANDLE == 1)
+        HeapHandleEntry handles[HEAP_HANDLE_NUM];
+        HeapBlockList *compactCursor; // compaction resumes here, heapEnd : nothing left to move
+#endif
         void (*enter_critical)(void);
         void (*exit_critical)(void);
+        /* statistics */
+        uint32_t blockNum;
+        uint32_t freeBlockNum;
+        uint32_t freeBytes;
+        uint32_t peakUsedBytes;
+        uint32_t mallocCount;
+        uint32_t freeCount;
+        uint32_t failedCount;
+        uint32_t invalidFreeCount;
+#if (HEAP_MANAGER_USE_MMAP == 1)
+        void *mappings;                  // blocks mapped directly
+        struct _HeapManager *segment;    // next segment, segments are locked by the heap that owns them
+        uint32_t mappedBytes;
+#endif
+#if (HEAP_MANAGER_USE_TLSF == 0)
+        uint32_t maxFreeBlock; // largest free block, refreshed by the best-fit walk
+        bool maxFreeDirty;     // maxFreeBlock was taken outside of a walk
+#endif
     } HeapManager;
+    /* Bump allocator over one heap block: no per-object header, everything is freed at once */
+    typedef struct
+    {
+        HeapManager *heap; // owner of the chunk
+        uint8_t *base;
+        uint32_t size;
+        uint32_t offset; // next free byte
+    } heap_mgr_arena_t;
     /**
      * @brief  Initilize the heap
      * @param  buffer: Heap buffer
@@ -57,6 +290,70 @@ extern "C"
      * @param  exit_critical exit_critical function
      */
     void heap_mgr_init(uint8_t *buffer, uint32_t size, void (*enter_critical)(void), void (*exit_critical)(void));
+#if (HEAP_MANAGER_USE_ZERO_TRACK == 1)
+    /**
+     * @brief  Initilize the heap over a zero filled buffer (e.g. static array in .bss)
+     *         calloc does not clear a block again until it has been used
+     * @param  buffer: Heap buffer, all zero
+     * @param  size: Size of heap
+     * @param  enter_critical enter_critical function
+     * @param  exit_critical exit_critical function
+     */
+    void heap_mgr_initZeroed(uint8_t *buffer, uint32_t size, void (*enter_critical)(void), void (*exit_critical)(void));
+#endif
+    /**
+     * @brief  Create an independent heap with its own lock, e.g. in another RAM region
+     *         The control block is placed at the start of the buffer
+     * @param  buffer: Heap buffer
+     * @param  size: Size of heap
+     * @param  enter_critical enter_critical function
+     * @param  exit_critical exit_critical function
+     * @retval Heap handle, NULL if the buffer is too small
+     */
+    HeapManager *heap_mgr_create(uint8_t *buffer, uint32_t size, void (*enter_critical)(void), void (*exit_critical)(void));
+    /**
+     * @brief  Disable a heap created by heap_mgr_create, the buffer belongs to the caller again
+     *         Every allocation from the heap returns NULL and every free is refused afterwards
+     *         With HEAP_MANAGER_USE_MMAP its mapped blocks and segments are unmapped
+     * @param  heap: Heap handle
+     * @retval void
+     */
+    void heap_mgr_destroy(HeapManager *heap);
+    /**
+     * @brief  Get the default heap used by the heap_mgr_* functions without handle
+     * @retval Heap handle
+     */
+    HeapManager *heap_mgr_getDefault(void);
+    /**
+     * @brief  Allocate memory from a heap
+     * @param  heap: Heap handle
+     * @param  size: Size
+     * @retval Pointer to the allocated memory
+     */
+    void *heap_mgr_malloc_from(HeapManager *heap, uint32_t size);
+    /**
+     * @brief  Allocate memory from a heap and initialize to zero
+     * @param  heap: Heap handle
+     * @param  nmemb: Number of elements
+     * @param  size: Size of each element
+     * @retval Pointer to the allocated memory
+     */
+    void *heap_mgr_calloc_from(HeapManager *heap, uint32_t nmemb, uint32_t size);
+    /**
+     * @brief  Free memory allocated from a heap
+     * @param  heap: Heap handle
+     * @param  ptr: Allocated memory address
+     * @retval void
+     */
+    void heap_mgr_free_from(HeapManager *heap, void *ptr);
+    /**
+     * @brief  Reallocate memory from a heap
+     * @param  heap: Heap handle
+     * @param  ptr: Allocated memory address
+     * @param  size: new size of the memory
+     * @retval Pointer to the allocated memory
+     */
+    void *heap_mgr_realloc_from(HeapManager *heap, void *ptr, uint32_t size);
     /**
      * @brief  Allocate memory and initialize
      * @param  size: Size
@@ -82,23 +379,270 @@ extern "C"
      * @retval Pointer to the allocated memory
      */
     void *heap_mgr_realloc(void *addrToPtr, uint32_t size);
+    /**
+     * @brief  Allocate memory aligned to align bytes (cache line, DMA, SIMD buffers)
+     *         The leading slack is given back to the heap, free it with heap_mgr_free
+     * @param  align: Alignment, power of 2
+     * @param  size: Size
+     * @retval Pointer to the allocated memory
+     */
+    void *heap_mgr_aligned_alloc(uint32_t align, uint32_t size);
+    /**
+     * @brief  Allocate aligned memory from a heap, free it with heap_mgr_free_from
+     * @param  heap: Heap handle
+     * @param  align: Alignment, power of 2
+     * @param  size: Size
+     * @retval Pointer to the allocated memory
+     */
+    void *heap_mgr_aligned_alloc_from(HeapManager *heap, uint32_t align, uint32_t size);
+    /**
+     * @brief  Allocate memory aligned to align bytes and initialize to zero
+     * @param  align: Alignment, power of 2
+     * @param  size: Size
+     * @retval Pointer to the allocated memory
+     */
+    void *heap_mgr_aligned_calloc(uint32_t align, uint32_t size);
+    /**
+     * @brief  Allocate aligned memory from a heap and initialize to zero
+     * @param  heap: Heap handle
+     * @param  align: Alignment, power of 2
+     * @param  size: Size
+     * @retval Pointer to the allocated memory
+     */
+    void *heap_mgr_aligned_calloc_from(HeapManager *heap, uint32_t align, uint32_t size);
     /**
      * @brief  Printf the status of the heap
      * @retval void
      */
     void heap_mgr_logHeapPool(void);
+    /**
+     * @brief  Get the heap statistics, O(1) so it can be polled every tick
+     *         Blocks held by the thread cache and pool slabs count as used
+     * @param  stats: Output
+     * @retval void
+     */
+    void heap_mgr_getStats(HeapStats *stats);
+    /**
+     * @brief  Get the statistics of a heap
+     * @param  heap: Heap handle
+     * @param  stats: Output
+     * @retval void
+     */
+    void heap_mgr_getStats_from(HeapManager *heap, HeapStats *stats);
     /**
      * @brief  Get the block
      * @param  ptr block address
      * @retval block infor
      */
     HeapBlockList *heap_mgr_getHeapBlock(void *ptr);
+    /**
+     * @brief  Take one chunk from a heap for an arena, the arena is not thread safe
+     * @param  arena: Output
+     * @param  heap: Heap handle
+     * @param  size: Capacity of the arena
+     * @retval true if success
+     */
+    bool heap_mgr_arena_init(heap_mgr_arena_t *arena, HeapManager *heap, uint32_t size);
+    /**
+     * @brief  Bump allocate from an arena, aligned to sizeof(void *)
+     * @param  arena
+     * @param  size: Size
+     * @retval Pointer to the allocated memory, NULL if the arena is full
+     */
+    void *heap_mgr_arena_malloc(heap_mgr_arena_t *arena, uint32_t size);
+    /**
+     * @brief  Free everything allocated from an arena in O(1), the chunk is kept
+     * @param  arena
+     * @retval void
+     */
+    void heap_mgr_arena_reset(heap_mgr_arena_t *arena);
+    /**
+     * @brief  Give the chunk of an arena back to its heap
+     * @param  arena
+     * @retval void
+     */
+    void heap_mgr_arena_destroy(heap_mgr_arena_t *arena);
     /**
      * @brief  Check if the heap manager is already been initilized
      * @param  void
      * @retval true if heap manager is initilized
      */
     bool heap_mgr_isInitilized(void);
+#if (HEAP_MANAGER_USE_THREAD_CACHE == 1)
+    /**
+     * @brief  Give all blocks cached by the calling thread back to the heap
+     *         Done automatically when the thread exits
+     * @retval void
+     */
+    void heap_mgr_flushThreadCache(void);
+#endif
+#if (HEAP_MANAGER_USE_POOL == 1)
+    /**
+     * @brief  Allocate a small object from the slab pools
+     * @param  size: Size, requests larger than 64 bytes fall back to heap_mgr_malloc
+     * @retval Pointer to the allocated memory
+     */
+    void *heap_mgr_pool_malloc(uint32_t size);
+    /**
+     * @brief  Give back an object allocated by heap_mgr_pool_malloc
+     *         A double free or a foreign pointer is refused and counted in invalidFreeCount.
+     *         With HEAP_MANAGER_USE_BLOCK_CHECK, pool malloc and free walk the slabs of the class
+     * @param  ptr: Object address
+     * @param  size: The size that was passed to heap_mgr_pool_malloc
+     * @retval void
+     */
+    void heap_mgr_pool_free(void *ptr, uint32_t size);
+    /**
+     * @brief  heap_mgr_pool_malloc on a given heap
+     */
+    void *heap_mgr_pool_malloc_from(HeapManager *heap, uint32_t size);
+    /**
+     * @brief  heap_mgr_pool_free on a given heap
+     */
+    void heap_mgr_pool_free_from(HeapManager *heap, void *ptr, uint32_t size);
+    /**
+     * @brief  Get the occupancy of a pool class
+     * @param  classIndex: 0 ~ HEAP_POOL_CLASS_NUM - 1
+     * @param  stats: Output
+     * @retval true if success
+     */
+    bool heap_mgr_pool_getStats(uint8_t classIndex, HeapPoolStats *stats);
+    /**
+     * @brief  heap_mgr_pool_getStats on a given heap
+     */
+    bool heap_mgr_pool_getStats_from(HeapManager *heap, uint8_t classIndex, HeapPoolStats *stats);
+    /**
+     * @brief  Printf the occupancy of all pool classes
+     * @retval void
+     */
+    void heap_mgr_pool_logStats(void);
+#endif
+#if (HEAP_MANAGER_USE_HANDLE == 1)
+    /**
+     * @brief  Allocate a relocatable block, get its address with heap_mgr_hlock
+     * @param  size: Size
+     * @retval Handle, 0 if failed
+     */
+    HeapHandle heap_mgr_halloc(uint32_t size);
+    /**
+     * @brief  Free a block allocated by heap_mgr_halloc
+     *         Refused and counted in invalidFreeCount while the block is locked by heap_mgr_hlock
+     * @param  handle
+     * @retval void
+     */
+    void heap_mgr_hfree(HeapHandle handle);
+    /**
+     * @brief  Pin a relocatable block, the address stays valid until the matching heap_mgr_hunlock
+     * @param  handle
+     * @retval Address of the block, NULL if the handle is invalid
+     */
+    void *heap_mgr_hlock(HeapHandle handle);
+    /**
+     * @brief  Unpin a relocatable block, heap_mgr_compact may move it again
+     * @param  handle
+     * @retval void
+     */
+    void heap_mgr_hunlock(HeapHandle handle);
+    /**
+     * @brief  Slide unpinned relocatable blocks down over free blocks, merging the free space
+     *         Each call resumes where the previous one stopped, frees and unpins in front of it rewind it.
+     *         Moves one block or walks HEAP_COMPACT_CHECK_BLOCKS if no clock is set by heap_mgr_setClock
+     * @param  budgetUs: Time budget of this call
+     * @retval Bytes moved, may be 0 before the end, see heap_mgr_isCompacted
+     */
+    uint32_t heap_mgr_compact(uint32_t budgetUs);
+    /**
+     * @brief  Check if heap_mgr_compact has nothing left to move
+     * @param  void
+     * @retval true if the walk reached the end of the heap since the last free or unpin
+     */
+    bool heap_mgr_isCompacted(void);
+    /**
+     * @brief  heap_mgr_halloc on a given heap
+     */
+    HeapHandle heap_mgr_halloc_from(HeapManager *heap, uint32_t size);
+    /**
+     * @brief  heap_mgr_hfree on a given heap
+     */
+    void heap_mgr_hfree_from(HeapManager *heap, HeapHandle handle);
+    /**
+     * @brief  heap_mgr_hlock on a given heap
+     */
+    void *heap_mgr_hlock_from(HeapManager *heap, HeapHandle handle);
+    /**
+     * @brief  heap_mgr_hunlock on a given heap
+     */
+    void heap_mgr_hunlock_from(HeapManager *heap, HeapHandle handle);
+    /**
+     * @brief  heap_mgr_compact on a given heap
+     */
+    uint32_t heap_mgr_compact_from(HeapManager *heap, uint32_t budgetUs);
+    /**
+     * @brief  heap_mgr_isCompacted on a given heap
+     */
+    bool heap_mgr_isCompacted_from(HeapManager *heap);
+    /**
+     * @brief  Set the microsecond clock used for the compaction budget, e.g. micros()
+     * @param  micros
+     * @retval void
+     */
+    void heap_mgr_setClock(uint32_t (*micros)(void));
+    /**
+     * @brief  Background compaction step for MillisTaskManager, runs for HEAP_COMPACT_TASK_BUDGET_US
+     *         MillisTaskManager_register(heap_mgr_compactTask, 100, true, NULL);
+     * @param  param: Heap handle, NULL for the default heap
+     * @retval void
+     */
+    void heap_mgr_compactTask(void *param);
+#endif
+#if (HEAP_MANAGER_USE_PROFILE == 1)
+    /**
+     * @brief  heap_mgr_malloc recording the allocation site in the block header
+     *         heap_mgr_malloc/calloc/realloc/aligned_alloc are redirected here with __FILE__/__LINE__
+     * @param  size: Size
+     * @param  file: Source file, NULL to record line as a user tag ID
+     * @param  line: Source line or user tag ID
+     * @retval Pointer to the allocated memory
+     */
+    void *heap_mgr_malloc_tag(uint32_t size, const char *file, uint32_t line);
+    /**
+     * @brief  heap_mgr_calloc recording the allocation site
+     */
+    void *heap_mgr_calloc_tag(uint32_t nmemb, uint32_t size, const char *file, uint32_t line);
+    /**
+     * @brief  heap_mgr_realloc recording the allocation site
+     */
+    void *heap_mgr_realloc_tag(void *ptr, uint32_t size, const char *file, uint32_t line);
+    /**
+     * @brief  heap_mgr_aligned_alloc recording the allocation site
+     */
+    void *heap_mgr_aligned_alloc_tag(uint32_t align, uint32_t size, const char *file, uint32_t line);
+    /**
+     * @brief  heap_mgr_aligned_calloc recording the allocation site
+     */
+    void *heap_mgr_aligned_calloc_tag(uint32_t align, uint32_t size, const char *file, uint32_t line);
+    /**
+     * @brief  Aggregate the live blocks of a heap per allocation site in one pass
+     * @param  heap: Heap handle
+     * @param  sites: Output, sorted by bytes, largest first
+     * @param  num: Capacity of sites
+     * @retval Number of sites stored, when more than num - 1 sites are live the last one sums up the rest as "other"
+     */
+    uint32_t heap_mgr_getProfile_from(HeapManager *heap, HeapProfileSite *sites, uint32_t num);
+    /**
+     * @brief  Printf live bytes per allocation site of the default heap, one CSV line per site:
+     *         profile,<file|tag>,<line|id>,<blocks>,<bytes>
+     *         Blocks held by the thread cache are reported untagged
+     *         Written with plain printf, no log prefix and also with HEAP_MANAGER_USE_LOG 0
+     * @retval void
+     */
+    void heap_mgr_dump_profile(void);
+#define heap_mgr_malloc(size) heap_mgr_malloc_tag((size), __FILE__, __LINE__)
+#define heap_mgr_calloc(nmemb, size) heap_mgr_calloc_tag((nmemb), (size), __FILE__, __LINE__)
+#define heap_mgr_realloc(ptr, size) heap_mgr_realloc_tag((ptr), (size), __FILE__, __LINE__)
+#define heap_mgr_aligned_alloc(align, size) heap_mgr_aligned_alloc_tag((align), (size), __FILE__, __LINE__)
+#define heap_mgr_aligned_calloc(align, size) heap_mgr_aligned_calloc_tag((align), (size), __FILE__, __LINE__)
+#endif
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,424 @@
+/*
+ * \file   heap_mgr_bench.c
+ * \brief  HeapManager benchmarks
+ *
+ * - Build (hosted):
+ *     gcc -O2 -pthread -I.. -I../../AccountManager -I../../AccountManager/PingPongBuffer \
+ *         -I../../AccountManager/RingBuffer heap_mgr_bench.c ../HeapManager.c -o heap_mgr_bench
+ *   Add -DHEAP_MANAGER_USE_TLSF=1 to compare the segregated fit index
+ *   against the best-fit list walk, -DHEAP_MANAGER_USE_THREAD_CACHE=1
+ *   to compare the thread scaling with per-thread magazines and
+ *   -DHEAP_MANAGER_BLOCK_LAYOUT=1 for the boundary tag block layout.
+ *   Build with -DHEAP_MANAGER_USE_BLOCK_CHECK=0 to get the unchecked free cost
+ *   and -DHEAP_MANAGER_USE_HANDLE=1 for the compaction bench,
+ *   -DHEAP_MANAGER_USE_MMAP=1 for the large ping-pong buffer bench.
+ */
+#include "HeapManager.h"
+#include "Account.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#define BENCH_HEAP_SIZE (4 * 1024 * 1024)
+#define BENCH_LIVE_BLOCKS 4000
+#define BENCH_ROUNDS 20000
+#define BENCH_MAX_THREADS 8
+#define BENCH_THREAD_OPS 200000
+#define BENCH_ACCOUNT_HEAP_SIZE (64 * 1024)
+#define BENCH_VECTOR_SIZE (64 * 1024)
+#define BENCH_VECTOR_STEP 64
+#define BENCH_VECTOR_ROUNDS 100
+#define BENCH_ARENA_OBJECTS 10000
+#define BENCH_ARENA_ROUNDS 100
+
+static uint8_t heap_buffer[BENCH_HEAP_SIZE];
+
+static uint64_t bench_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * @brief  malloc/free latency on a fragmented heap
+ *         Keep BENCH_LIVE_BLOCKS blocks alive with a hole between each of them,
+ *         then replace random blocks with random sizes.
+ */
+static void bench_fragmented_malloc(void)
+{
+    static void *live[BENCH_LIVE_BLOCKS];
+    void *holes[BENCH_LIVE_BLOCKS];
+    heap_mgr_init(heap_buffer, sizeof(heap_buffer), NULL, NULL);
+    srand(1);
+    for (int i = 0; i < BENCH_LIVE_BLOCKS; i++)
+    {
+        holes[i] = heap_mgr_malloc(16 + rand() % 256);
+        live[i] = heap_mgr_malloc(16 + rand() % 256);
+    }
+    for (int i = 0; i < BENCH_LIVE_BLOCKS; i++)
+    {
+        heap_mgr_free(holes[i]);
+    }
+
+    uint64_t total = 0, worst = 0;
+    uint32_t failed = 0;
+    for (int i = 0; i < BENCH_ROUNDS; i++)
+    {
+        int idx = rand() % BENCH_LIVE_BLOCKS;
+        uint32_t size = 16 + rand() % 256;
+        uint64_t t0 = bench_now_ns();
+        heap_mgr_free(live[idx]);
+        live[idx] = heap_mgr_malloc(size);
+        uint64_t dt = bench_now_ns() - t0;
+        total += dt;
+        if (dt > worst)
+            worst = dt;
+        if (live[idx] == NULL)
+            failed++;
+    }
+    printf("fragmented malloc+free (TLSF=%d): avg %llu ns, worst %llu ns, failed %u\n",
+           HEAP_MANAGER_USE_TLSF, (unsigned long long)(total / BENCH_ROUNDS),
+           (unsigned long long)worst, failed);
+#if (HEAP_MANAGER_USE_THREAD_CACHE == 1)
+    heap_mgr_flushThreadCache(); // the next benchmark re-initializes the heap
+#endif
+}
+
+static pthread_mutex_t bench_lock = PTHREAD_MUTEX_INITIALIZER;
+static void bench_lock_enter(void)
+{
+    pthread_mutex_lock(&bench_lock);
+}
+static void bench_lock_exit(void)
+{
+    pthread_mutex_unlock(&bench_lock);
+}
+static void *bench_thread_worker(void *arg)
+{
+    void *slots[64] = {0};
+    uint32_t seed = (uint32_t)(uintptr_t)arg;
+    for (int i = 0; i < BENCH_THREAD_OPS; i++)
+    {
+        seed = seed * 1103515245u + 12345u;
+        int idx = (seed >> 16) % 64;
+        heap_mgr_free(slots[idx]);
+        slots[idx] = heap_mgr_malloc(16 + (seed >> 8) % 200);
+    }
+    for (int i = 0; i < 64; i++)
+    {
+        heap_mgr_free(slots[i]);
+    }
+    return NULL;
+}
+/**
+ * @brief  Small object malloc/free throughput against thread count
+ */
+static void bench_thread_scaling(void)
+{
+    pthread_t threads[BENCH_MAX_THREADS];
+    for (int n = 1; n <= BENCH_MAX_THREADS; n *= 2)
+    {
+        heap_mgr_init(heap_buffer, sizeof(heap_buffer), bench_lock_enter, bench_lock_exit);
+        uint64_t t0 = bench_now_ns();
+        for (int i = 0; i < n; i++)
+        {
+            pthread_create(&threads[i], NULL, bench_thread_worker, (void *)(uintptr_t)(i + 1));
+        }
+        for (int i = 0; i < n; i++)
+        {
+            pthread_join(threads[i], NULL);
+        }
+        double sec = (bench_now_ns() - t0) / 1e9;
+        printf("threads %d (thread cache=%d): %.2f M allocs/s\n",
+               n, HEAP_MANAGER_USE_THREAD_CACHE, n * (double)BENCH_THREAD_OPS / sec / 1e6);
+    }
+}
+
+/**
+ * @brief  Memory efficiency: how many Account objects (Account + AccountPoolList node,
+ *         as AccountManager_CreateAccount allocates them) fit in a fixed buffer
+ */
+static void bench_account_capacity(void)
+{
+    heap_mgr_init(heap_buffer, BENCH_ACCOUNT_HEAP_SIZE, NULL, NULL);
+    uint32_t num = 0;
+    while (true)
+    {
+        void *account = heap_mgr_malloc(sizeof(Account));
+        void *node = heap_mgr_malloc(sizeof(AccountPoolList));
+        // With the mmap backend the heap grows instead of failing
+        if (account == NULL || node == NULL || (uint8_t *)node >= heap_buffer + BENCH_ACCOUNT_HEAP_SIZE ||
+            (uint8_t *)account >= heap_buffer + BENCH_ACCOUNT_HEAP_SIZE)
+            break;
+        num++;
+    }
+    uint32_t payload = num * (uint32_t)(sizeof(Account) + sizeof(AccountPoolList));
+    printf("accounts in %d KB (layout=%d, header %d bytes): %u, payload efficiency %.1f%%\n",
+           BENCH_ACCOUNT_HEAP_SIZE / 1024, HEAP_MANAGER_BLOCK_LAYOUT, (int)sizeof(HeapBlockList),
+           num, 100.0 * payload / BENCH_ACCOUNT_HEAP_SIZE);
+#if (HEAP_MANAGER_USE_THREAD_CACHE == 1)
+    heap_mgr_flushThreadCache();
+#endif
+}
+
+/**
+ * @brief  The realloc strategy before in-place growth: always malloc, copy and free
+ */
+static void *bench_copy_realloc(void *ptr, uint32_t old_size, uint32_t new_size)
+{
+    void *new_ptr = heap_mgr_malloc(new_size);
+    if (new_ptr != NULL)
+    {
+        memcpy(new_ptr, ptr, old_size);
+        heap_mgr_free(ptr);
+    }
+    return new_ptr;
+}
+/**
+ * @brief  Grow a vector to BENCH_VECTOR_SIZE, a small block is kept alive every
+ *         64 steps so that the vector sometimes has to move
+ */
+static void bench_vector_growth(bool inPlace)
+{
+    static void *small[BENCH_VECTOR_SIZE / BENCH_VECTOR_STEP / 64 + 1];
+    uint64_t copies = 0, copiedBytes = 0;
+    heap_mgr_init(heap_buffer, sizeof(heap_buffer), NULL, NULL);
+    uint64_t t0 = bench_now_ns();
+    for (int r = 0; r < BENCH_VECTOR_ROUNDS; r++)
+    {
+        uint32_t size = BENCH_VECTOR_STEP;
+        uint32_t smallNum = 0;
+        uint8_t *vec = (uint8_t *)heap_mgr_malloc(size);
+        while (size < BENCH_VECTOR_SIZE)
+        {
+            uint32_t new_size = size + BENCH_VECTOR_STEP;
+            uint8_t *new_vec = inPlace ? (uint8_t *)heap_mgr_realloc(vec, new_size)
+                                       : (uint8_t *)bench_copy_realloc(vec, size, new_size);
+            if (new_vec != vec)
+            {
+                copies++;
+                copiedBytes += size;
+            }
+            vec = new_vec;
+            vec[size] = (uint8_t)size;
+            size = new_size;
+            if ((size / BENCH_VECTOR_STEP) % 64 == 0)
+            {
+                small[smallNum++] = heap_mgr_malloc(32);
+            }
+        }
+        heap_mgr_free(vec);
+        while (smallNum)
+        {
+            heap_mgr_free(small[--smallNum]);
+        }
+    }
+    printf("vector growth to %d KB (%s): %.1f copies, %.1f KB copied, %llu us per vector\n",
+           BENCH_VECTOR_SIZE / 1024, inPlace ? "in-place realloc" : "malloc+copy",
+           (double)copies / BENCH_VECTOR_ROUNDS, copiedBytes / 1024.0 / BENCH_VECTOR_ROUNDS,
+           (unsigned long long)((bench_now_ns() - t0) / 1000 / BENCH_VECTOR_ROUNDS));
+#if (HEAP_MANAGER_USE_THREAD_CACHE == 1)
+    heap_mgr_flushThreadCache();
+#endif
+}
+
+/**
+ * @brief  Cost of the free validation: free BENCH_LIVE_BLOCKS blocks in a random order,
+ *         then check that a double free and a foreign pointer are rejected
+ */
+static void bench_free_check(void)
+{
+    static void *blocks[BENCH_LIVE_BLOCKS];
+    uint64_t total = 0;
+    int rounds = BENCH_ROUNDS / 1000;
+    srand(2);
+    for (int r = 0; r < rounds; r++)
+    {
+        heap_mgr_init(heap_buffer, sizeof(heap_buffer), NULL, NULL);
+        for (int i = 0; i < BENCH_LIVE_BLOCKS; i++)
+        {
+            blocks[i] = heap_mgr_malloc(16 + rand() % 256);
+        }
+        for (int i = BENCH_LIVE_BLOCKS - 1; i > 0; i--)
+        {
+            int j = rand() % (i + 1);
+            void *tmp = blocks[i];
+            blocks[i] = blocks[j];
+            blocks[j] = tmp;
+        }
+        uint64_t t0 = bench_now_ns();
+        for (int i = 0; i < BENCH_LIVE_BLOCKS; i++)
+        {
+            heap_mgr_free(blocks[i]);
+        }
+        total += bench_now_ns() - t0;
+#if (HEAP_MANAGER_USE_THREAD_CACHE == 1)
+        heap_mgr_flushThreadCache();
+#endif
+    }
+    printf("free (BLOCK_CHECK=%d): %.1f ns per free\n", HEAP_MANAGER_USE_BLOCK_CHECK,
+           (double)total / rounds / BENCH_LIVE_BLOCKS);
+#if (HEAP_MANAGER_USE_BLOCK_CHECK == 1)
+    static uint8_t foreign[64];
+    HeapStats stats;
+    void *p = heap_mgr_malloc(64);
+    heap_mgr_free(p);
+    heap_mgr_free(p);
+    heap_mgr_free(foreign + sizeof(HeapBlockList));
+    heap_mgr_free((uint8_t *)heap_mgr_malloc(64) + sizeof(void *));
+    heap_mgr_getStats(&stats);
+    printf("invalid frees rejected: %u of 3\n", stats.invalidFreeCount);
+#if (HEAP_MANAGER_USE_THREAD_CACHE == 1)
+    heap_mgr_flushThreadCache();
+#endif
+#endif
+}
+
+/**
+ * @brief  Per-frame workload: BENCH_ARENA_OBJECTS small objects freed together,
+ *         heap_mgr_malloc/heap_mgr_free against one arena chunk and heap_mgr_arena_reset
+ */
+static void bench_arena(void)
+{
+    static void *objects[BENCH_ARENA_OBJECTS];
+    heap_mgr_arena_t arena;
+    uint64_t heapNs = 0, arenaNs = 0;
+    heap_mgr_init(heap_buffer, sizeof(heap_buffer), NULL, NULL);
+    heap_mgr_arena_init(&arena, heap_mgr_getDefault(), BENCH_ARENA_OBJECTS * 64);
+    for (int r = 0; r < BENCH_ARENA_ROUNDS; r++)
+    {
+        uint64_t t0 = bench_now_ns();
+        for (int i = 0; i < BENCH_ARENA_OBJECTS; i++)
+        {
+            objects[i] = heap_mgr_malloc(16 + (i & 31));
+        }
+        for (int i = 0; i < BENCH_ARENA_OBJECTS; i++)
+        {
+            heap_mgr_free(objects[i]);
+        }
+        uint64_t t1 = bench_now_ns();
+        for (int i = 0; i < BENCH_ARENA_OBJECTS; i++)
+        {
+            objects[i] = heap_mgr_arena_malloc(&arena, 16 + (i & 31));
+        }
+        heap_mgr_arena_reset(&arena);
+        uint64_t t2 = bench_now_ns();
+        heapNs += t1 - t0;
+        arenaNs += t2 - t1;
+    }
+    heap_mgr_arena_destroy(&arena);
+    printf("%d small objects: heap_mgr_malloc+free %llu us, arena+reset %llu us\n", BENCH_ARENA_OBJECTS,
+           (unsigned long long)(heapNs / 1000 / BENCH_ARENA_ROUNDS),
+           (unsigned long long)(arenaNs / 1000 / BENCH_ARENA_ROUNDS));
+#if (HEAP_MANAGER_USE_THREAD_CACHE == 1)
+    heap_mgr_flushThreadCache();
+#endif
+}
+
+#if (HEAP_MANAGER_USE_HANDLE == 1)
+static uint32_t bench_micros(void)
+{
+    return (uint32_t)(bench_now_ns() / 1000);
+}
+/**
+ * @brief  Fragment the heap with relocatable blocks, free every other one, then compact
+ *         with a 100 us budget per call until nothing is left to move
+ */
+static void bench_compaction(void)
+{
+    static HeapHandle handles[HEAP_HANDLE_NUM];
+    HeapStats stats;
+    heap_mgr_init(heap_buffer, BENCH_ACCOUNT_HEAP_SIZE, NULL, NULL);
+    heap_mgr_setClock(bench_micros);
+    srand(4);
+    for (int i = 0; i < HEAP_HANDLE_NUM; i++)
+    {
+        handles[i] = heap_mgr_halloc(256 + rand() % 1536);
+    }
+    for (int i = 0; i < HEAP_HANDLE_NUM; i += 2)
+    {
+        heap_mgr_hfree(handles[i]);
+    }
+    heap_mgr_getStats(&stats);
+    uint32_t before = stats.largestFreeBlock;
+    uint32_t moved = 0, calls = 0;
+    uint64_t t0 = bench_now_ns();
+    while (!heap_mgr_isCompacted())
+    {
+        moved += heap_mgr_compact(100);
+        calls++;
+    }
+    uint64_t dt = bench_now_ns() - t0;
+    heap_mgr_getStats(&stats);
+    printf("compaction: largest free %u -> %u bytes, %u bytes moved in %u calls, %llu us\n",
+           before, stats.largestFreeBlock, moved, calls, (unsigned long long)(dt / 1000));
+    heap_mgr_setClock(NULL);
+}
+#endif
+
+#if (HEAP_MANAGER_USE_MMAP == 1)
+#define BENCH_MMAP_BUFFERS 16
+#define BENCH_MMAP_BUFFER_SIZE (512 * 1024)
+/**
+ * @brief  Big ping-pong buffers (two halves each) and many small blocks on a 64 KB heap buffer,
+ *         everything that does not fit is mapped
+ */
+static void bench_mmap(void)
+{
+    static void *buffers[BENCH_MMAP_BUFFERS];
+    static void *small[BENCH_LIVE_BLOCKS];
+    HeapStats stats;
+    uint32_t failed = 0;
+    heap_mgr_init(heap_buffer, BENCH_ACCOUNT_HEAP_SIZE, NULL, NULL);
+    uint64_t t0 = bench_now_ns();
+    for (int i = 0; i < BENCH_MMAP_BUFFERS; i++)
+    {
+        buffers[i] = heap_mgr_calloc(2, BENCH_MMAP_BUFFER_SIZE / 2);
+        failed += buffers[i] == NULL;
+    }
+    for (int i = 0; i < BENCH_LIVE_BLOCKS; i++)
+    {
+        small[i] = heap_mgr_malloc(16 + i % 256);
+        failed += small[i] == NULL;
+    }
+    uint64_t dt = bench_now_ns() - t0;
+    heap_mgr_getStats(&stats);
+    printf("mmap backend: %d x %d KB buffers + %d small blocks on a %d KB heap, %u failed, %u KB mapped, %llu us\n",
+           BENCH_MMAP_BUFFERS, BENCH_MMAP_BUFFER_SIZE / 1024, BENCH_LIVE_BLOCKS, BENCH_ACCOUNT_HEAP_SIZE / 1024,
+           failed, stats.mappedBytes / 1024, (unsigned long long)(dt / 1000));
+    for (int i = 0; i < BENCH_MMAP_BUFFERS; i++)
+    {
+        heap_mgr_free(buffers[i]);
+    }
+    for (int i = 0; i < BENCH_LIVE_BLOCKS; i++)
+    {
+        heap_mgr_free(small[i]);
+    }
+#if (HEAP_MANAGER_USE_THREAD_CACHE == 1)
+    heap_mgr_flushThreadCache();
+#endif
+    heap_mgr_getStats(&stats);
+    printf("mmap backend: %u KB mapped after free\n", stats.mappedBytes / 1024);
+}
+#endif
+
+int main(void)
+{
+    bench_account_capacity();
+    bench_fragmented_malloc();
+    bench_vector_growth(false);
+    bench_vector_growth(true);
+    bench_thread_scaling();
+    bench_free_check();
+    bench_arena();
+#if (HEAP_MANAGER_USE_HANDLE == 1)
+    bench_compaction();
+#endif
+#if (HEAP_MANAGER_USE_MMAP == 1)
+    bench_mmap();
+#endif
+    return 0;
+}
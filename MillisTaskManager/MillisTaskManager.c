@@ -13,6 +13,11 @@
  */
 #include "MillisTaskManager.h"
 #include "HeapManager.h"
+#include <stdlib.h>
+#if (MTM_USE_WORKER_POOL == 1)
+#include <pthread.h>
+#include <sched.h>
+#endif
 
 
 
@@ -26,7 +31,8 @@
     do                                                       \
     {                                                        \
         task = (Task_t *)__MALLOC(sizeof(Task_t)); \
-        memset(task, 0, sizeof(Task_t));                     \
+        if (task != NULL)                                    \
+            memset(task, 0, sizeof(Task_t));                 \
     } while (0)
 #define TASK_DEL(task)          \
     do                          \
@@ -34,9 +40,39 @@
         __FREE(task); \
     } while (0)
 static Task_t *MillisTaskManager_findTask(TaskFunction_t func);
+static void MillisTaskManager_schedule(Task_t *task);
 
 static MillisTaskManager *TaskManager = NULL;
 
+/**
+ * @brief  Check if a task is still queued or running on a worker
+ * @param  task
+ * @retval true if it must not be dispatched again
+ */
+static inline bool MillisTaskManager_isBusy(Task_t *task)
+{
+#if (MTM_USE_WORKER_POOL == 1)
+    return atomic_load_explicit(&task->Busy, memory_order_acquire);
+#else
+    (void)task;
+    return false;
+#endif
+}
+/**
+ * @brief  Wait until a task is neither queued nor running on a worker
+ * @param  task
+ * @retval 无
+ */
+static void MillisTaskManager_waitIdle(Task_t *task)
+{
+    while (MillisTaskManager_isBusy(task))
+    {
+#if (MTM_USE_WORKER_POOL == 1)
+        sched_yield();
+#endif
+    }
+}
+
 /**
  * @brief  Initlize the millis task manager
  * @param  priorityEnable
@@ -47,6 +83,7 @@ void MillisTaskManager_Init(bool priorityEnable)
     TaskManager = (MillisTaskManager *)__MALLOC(sizeof(MillisTaskManager));
     if (TaskManager)
     {
+        memset(TaskManager, 0, sizeof(MillisTaskManager));
         TaskManager->Head = NULL;
         TaskManager->Tail = NULL;
         TaskManager->PriorityEnable = priorityEnable;
@@ -59,6 +96,9 @@ void MillisTaskManager_Init(bool priorityEnable)
  */
 void MillisTaskManager_DeInit()
 {
+#if (MTM_USE_WORKER_POOL == 1)
+    MillisTaskManager_stopWorkers();
+#endif
     Task_t *now = TaskManager->Head;
     while (true)
     {
@@ -68,15 +108,19 @@ void MillisTaskManager_DeInit()
         now = now->Next;
         TASK_DEL(now_del);
     }
+#if (MTM_SCHEDULER == MTM_SCHEDULER_HEAP)
+    __FREE(TaskManager->Queue);
+#endif
+    __FREE(TaskManager->Run);
     if (TaskManager)
     {
         __FREE(TaskManager);
     }
 }
 /**
- * @brief  Delete the millis Task manager
- * @param  无
- * @retval 无
+ * @brief  Find the first task registered with a function
+ * @param  func
+ * @retval Task, NULL if not found
  */
 static Task_t *MillisTaskManager_findTask(TaskFunction_t func)
 {
@@ -95,8 +139,341 @@ static Task_t *MillisTaskManager_findTask(TaskFunction_t func)
     }
     return task;
 }
+#if (MTM_SCHEDULER == MTM_SCHEDULER_WHEEL)
+#define MTM_WHEEL_RANGE (1u << (MTM_WHEEL_SLOT_LOG2 * MTM_WHEEL_LEVEL_NUM))
+/**
+ * @brief  Append a task to a slot list, head->SlotPrev is the tail
+ * @param  list
+ * @param  task
+ * @retval 无
+ */
+static void MillisTaskManager_listAppend(Task_t **list, Task_t *task)
+{
+    task->Slot = list;
+    task->SlotNext = NULL;
+    if (*list == NULL)
+    {
+        task->SlotPrev = task;
+        *list = task;
+    }
+    else
+    {
+        Task_t *tail = (*list)->SlotPrev;
+        tail->SlotNext = task;
+        task->SlotPrev = tail;
+        (*list)->SlotPrev = task;
+    }
+}
+/**
+ * @brief  Unlink a task from the slot list it is in
+ * @param  task
+ * @retval 无
+ */
+static void MillisTaskManager_listRemove(Task_t *task)
+{
+    Task_t **list = task->Slot;
+    if (task == *list)
+    {
+        *list = task->SlotNext;
+        if (*list != NULL)
+        {
+            (*list)->SlotPrev = task->SlotPrev;
+        }
+    }
+    else
+    {
+        task->SlotPrev->SlotNext = task->SlotNext;
+        if (task->SlotNext != NULL)
+        {
+            task->SlotNext->SlotPrev = task->SlotPrev;
+        }
+        else
+        {
+            (*list)->SlotPrev = task->SlotPrev;
+        }
+    }
+    task->Slot = NULL;
+    // Keep the bitmap of non-empty wheel slots up to date
+    uintptr_t index = (uintptr_t)(list - &TaskManager->Wheel[0][0]);
+    if (*list == NULL && index < MTM_WHEEL_LEVEL_NUM * MTM_WHEEL_SLOT_NUM)
+    {
+        TaskManager->WheelBitmap[index >> MTM_WHEEL_SLOT_LOG2] &= ~(1u << (index & (MTM_WHEEL_SLOT_NUM - 1)));
+    }
+}
+/**
+ * @brief  Put a task in the slot of TimePrev + Time, or in the ready list if it is due
+ *         Due means the same as in the list scan: MillisTaskManager_getTickElaps >= Time
+ *         Deadlines beyond the wheel range wait in the last slot and are cascaded again
+ * @param  task
+ * @retval 无
+ */
+static void MillisTaskManager_wheelInsert(Task_t *task)
+{
+    uint32_t elapsTime = MillisTaskManager_getTickElaps(TaskManager->WheelTick, task->TimePrev);
+    if (elapsTime >= task->Time)
+    {
+        MillisTaskManager_listAppend(&TaskManager->Ready, task);
+        return;
+    }
+    uint32_t ticks = task->Time - elapsTime;
+    if (ticks >= MTM_WHEEL_RANGE)
+    {
+        ticks = MTM_WHEEL_RANGE - 1;
+    }
+    uint32_t expires = TaskManager->WheelTick + ticks;
+    uint8_t level = 0;
+    while (ticks >> (MTM_WHEEL_SLOT_LOG2 * (level + 1)) != 0)
+    {
+        level++;
+    }
+    uint32_t slot = (expires >> (MTM_WHEEL_SLOT_LOG2 * level)) & (MTM_WHEEL_SLOT_NUM - 1);
+    MillisTaskManager_listAppend(&TaskManager->Wheel[level][slot], task);
+    TaskManager->WheelBitmap[level] |= 1u << slot;
+}
+/**
+ * @brief  Move the tasks of a slot one level down (level 0: into the ready list)
+ * @param  level
+ * @param  slot
+ * @retval 无
+ */
+static void MillisTaskManager_wheelCascade(uint8_t level, uint32_t slot)
+{
+    Task_t *now = TaskManager->Wheel[level][slot];
+    TaskManager->Wheel[level][slot] = NULL;
+    TaskManager->WheelBitmap[level] &= ~(1u << slot);
+    while (now != NULL)
+    {
+        Task_t *next = now->SlotNext;
+        MillisTaskManager_wheelInsert(now);
+        now = next;
+    }
+}
+/**
+ * @brief  Advance the wheel to tick, the due tasks end up in the ready list
+ *         Ticks without anything to do are skipped using the slot bitmaps
+ * @param  tick
+ * @retval 无
+ */
+static void MillisTaskManager_wheelAdvance(uint32_t tick)
+{
+    while (tick != TaskManager->WheelTick)
+    {
+        uint8_t level = 0;
+        while (level < MTM_WHEEL_LEVEL_NUM && TaskManager->WheelBitmap[level] == 0)
+        {
+            level++;
+        }
+        uint32_t next = tick;
+        if (level == 0)
+        {
+            next = TaskManager->WheelTick + 1;
+        }
+        else if (level < MTM_WHEEL_LEVEL_NUM)
+        {
+            // Lower levels are empty, nothing happens before their next cascade
+            uint32_t boundary = (TaskManager->WheelTick | ((1u << (MTM_WHEEL_SLOT_LOG2 * level)) - 1)) + 1;
+            if (boundary - TaskManager->WheelTick < tick - TaskManager->WheelTick)
+            {
+                next = boundary;
+            }
+        }
+        TaskManager->WheelTick = next;
+        for (level = MTM_WHEEL_LEVEL_NUM - 1; level > 0; level--)
+        {
+            if ((next & ((1u << (MTM_WHEEL_SLOT_LOG2 * level)) - 1)) == 0)
+            {
+                MillisTaskManager_wheelCascade(level, (next >> (MTM_WHEEL_SLOT_LOG2 * level)) & (MTM_WHEEL_SLOT_NUM - 1));
+            }
+        }
+        MillisTaskManager_wheelCascade(0, next & (MTM_WHEEL_SLOT_NUM - 1));
+    }
+}
+#elif (MTM_SCHEDULER == MTM_SCHEDULER_HEAP)
+/**
+ * @brief  Queue order: earlier deadline first, among equal deadlines the task that ran longer ago
+ * @param  a
+ * @param  b
+ * @retval true if a runs before b
+ */
+static bool MillisTaskManager_queueBefore(Task_t *a, Task_t *b)
+{
+    int32_t diff = (int32_t)(a->Deadline - b->Deadline);
+    if (diff != 0)
+    {
+        return diff < 0;
+    }
+    return (int32_t)(a->Round - b->Round) < 0; // a task rearmed with period 0 waits for the next call
+}
+/**
+ * @brief  Place a task at a queue position
+ * @param  index
+ * @param  task
+ * @retval 无
+ */
+static void MillisTaskManager_queueSet(uint32_t index, Task_t *task)
+{
+    TaskManager->Queue[index] = task;
+    task->QueueIndex = index + 1;
+}
+/**
+ * @brief  Move the task at index towards the root
+ * @param  index
+ * @retval 无
+ */
+static void MillisTaskManager_queueUp(uint32_t index)
+{
+    Task_t *task = TaskManager->Queue[index];
+    while (index > 0)
+    {
+        uint32_t parent = (index - 1) / 2;
+        if (!MillisTaskManager_queueBefore(task, TaskManager->Queue[parent]))
+        {
+            break;
+        }
+        MillisTaskManager_queueSet(index, TaskManager->Queue[parent]);
+        index = parent;
+    }
+    MillisTaskManager_queueSet(index, task);
+}
+/**
+ * @brief  Move the task at index towards the leaves
+ * @param  index
+ * @retval 无
+ */
+static void MillisTaskManager_queueDown(uint32_t index)
+{
+    Task_t *task = TaskManager->Queue[index];
+    while (true)
+    {
+        uint32_t child = index * 2 + 1;
+        if (child >= TaskManager->QueueNum)
+        {
+            break;
+        }
+        if (child + 1 < TaskManager->QueueNum && MillisTaskManager_queueBefore(TaskManager->Queue[child + 1], TaskManager->Queue[child]))
+        {
+            child++;
+        }
+        if (!MillisTaskManager_queueBefore(TaskManager->Queue[child], task))
+        {
+            break;
+        }
+        MillisTaskManager_queueSet(index, TaskManager->Queue[child]);
+        index = child;
+    }
+    MillisTaskManager_queueSet(index, task);
+}
+/**
+ * @brief  Deadline seen from the last tick, due tasks get the last tick
+ *         Due means the same as in the list scan: MillisTaskManager_getTickElaps >= Time
+ * @param  task
+ * @retval 无
+ */
+static void MillisTaskManager_queueDeadline(Task_t *task)
+{
+    uint32_t elapsTime = MillisTaskManager_getTickElaps(TaskManager->Tick, task->TimePrev);
+    task->Deadline = TaskManager->Tick + (elapsTime >= task->Time ? 0 : task->Time - elapsTime);
+}
 /**
- * @brief  Register a task in the task manager
+ * @brief  Add a task to the queue, the capacity is reserved by register
+ * @param  task
+ * @retval 无
+ */
+static void MillisTaskManager_queuePush(Task_t *task)
+{
+    MillisTaskManager_queueDeadline(task);
+    TaskManager->Queue[TaskManager->QueueNum] = task;
+    TaskManager->QueueNum++;
+    MillisTaskManager_queueUp(TaskManager->QueueNum - 1);
+}
+/**
+ * @brief  Remove a task from any queue position
+ * @param  task
+ * @retval 无
+ */
+static void MillisTaskManager_queueRemove(Task_t *task)
+{
+    uint32_t index = task->QueueIndex - 1;
+    Task_t *last = TaskManager->Queue[--TaskManager->QueueNum];
+    task->QueueIndex = 0;
+    if (last != task)
+    {
+        MillisTaskManager_queueSet(index, last);
+        MillisTaskManager_queueUp(index);
+        MillisTaskManager_queueDown(last->QueueIndex - 1);
+    }
+}
+/**
+ * @brief  Grow the queue to hold num tasks
+ * @param  num
+ * @retval true if success
+ */
+static bool MillisTaskManager_queueReserve(uint32_t num)
+{
+    if (num <= TaskManager->QueueCapacity)
+    {
+        return true;
+    }
+    uint32_t capacity = TaskManager->QueueCapacity != 0 ? TaskManager->QueueCapacity * 2 : 8;
+    Task_t **queue = (Task_t **)__REALLOC(TaskManager->Queue, capacity * sizeof(Task_t *));
+    if (queue == NULL)
+    {
+        MILLISTASK__ERROR("Task queue grow to %u failed", (unsigned)capacity);
+        return false;
+    }
+    TaskManager->Queue = queue;
+    TaskManager->QueueCapacity = capacity;
+    return true;
+}
+/**
+ * @brief  Recompute every deadline from a new tick, used when the tick jumped by 2^31 or more
+ * @param  tick
+ * @retval 无
+ */
+static void MillisTaskManager_queueRebuild(uint32_t tick)
+{
+    TaskManager->Tick = tick;
+    for (uint32_t i = 0; i < TaskManager->QueueNum; i++)
+    {
+        MillisTaskManager_queueDeadline(TaskManager->Queue[i]);
+    }
+    for (uint32_t i = TaskManager->QueueNum / 2; i > 0; i--)
+    {
+        MillisTaskManager_queueDown(i - 1);
+    }
+}
+#endif
+/**
+ * @brief  Recompute the deadline after TimePrev, Time or State changed
+ * @param  task
+ * @retval 无
+ */
+static void MillisTaskManager_schedule(Task_t *task)
+{
+#if (MTM_SCHEDULER == MTM_SCHEDULER_WHEEL)
+    if (task->Slot != NULL)
+    {
+        MillisTaskManager_listRemove(task);
+    }
+    if (task->Function != NULL && task->State)
+    {
+        MillisTaskManager_wheelInsert(task); // disabled tasks are inserted again by setTaskState
+    }
+#elif (MTM_SCHEDULER == MTM_SCHEDULER_HEAP)
+    if (task->QueueIndex != 0)
+    {
+        MillisTaskManager_queueRemove(task);
+    }
+    if (task->Function != NULL && task->State)
+    {
+        MillisTaskManager_queuePush(task); // disabled tasks are pushed again by setTaskState
+    }
+#else
+    (void)task;
+#endif
+}
+/**
+ * @brief  Register a task in the task manager, a task with the same function is updated instead
  * @param  func:Function
  * @param  timeMs:Task period
  * @param  state
@@ -110,13 +487,34 @@ Task_t *MillisTaskManager_register(TaskFunction_t func, uint32_t timeMs, bool st
         // Update info
         task->Time = timeMs;
         task->State = state;
+        MillisTaskManager_schedule(task);
         return task;
     }
+    return MillisTaskManager_registerH(func, timeMs, state, param);
+}
+/**
+ * @brief  Register a new task, the same function may be registered several times
+ * @param  func:Function
+ * @param  timeMs:Task period
+ * @param  state
+ * @param  param
+ * @retval Task handle for the *H functions, NULL if out of memory
+ */
+Task_t *MillisTaskManager_registerH(TaskFunction_t func, uint32_t timeMs, bool state, void *param)
+{
+    Task_t *task;
     TASK_NEW(task);
     if (task == NULL)
     {
         return NULL;
     }
+#if (MTM_SCHEDULER == MTM_SCHEDULER_HEAP)
+    if (!MillisTaskManager_queueReserve(TaskManager->TaskNum + 1))
+    {
+        TASK_DEL(task);
+        return NULL;
+    }
+#endif
     task->param = param;
     task->Function = func; // 任务回调函数
     task->Time = timeMs;   // 任务执行周期
@@ -125,6 +523,7 @@ Task_t *MillisTaskManager_register(TaskFunction_t func, uint32_t timeMs, bool st
     task->TimeCost = 0;    // 时间开销
     task->TimeError = 0;   // 误差时间
     task->Next = NULL;     // 下一个节点
+    task->Prev = TaskManager->Tail;
 
     /*如果任务链表为空*/
     if (TaskManager->Head == NULL)
@@ -140,34 +539,10 @@ Task_t *MillisTaskManager_register(TaskFunction_t func, uint32_t timeMs, bool st
 
     /*将当前任务作为链表的尾*/
     TaskManager->Tail = task;
+    TaskManager->TaskNum++;
+    MillisTaskManager_schedule(task);
     return task;
 }
-/**
- * @brief  Get the pre node
- * @param  task:当前任务节点地址
- * @retval 前一个任务节点地址
- */
-Task_t *MillisTaskManager_getPrevNode(Task_t *task)
-{
-    Task_t *now = TaskManager->Head; // 当前节点
-    Task_t *prev = NULL;             // 前一节点
-    Task_t *retval = NULL;           // 被返回的节点
-    while (true)
-    {
-        if (now == NULL)
-        {
-            break;
-        }
-        if (now == task)
-        {
-            retval = prev;
-            break;
-        }
-        prev = now;
-        now = now->Next;
-    }
-    return retval;
-}
 
 /**
  * @brief  Unregister Task
@@ -176,24 +551,53 @@ Task_t *MillisTaskManager_getPrevNode(Task_t *task)
  */
 bool MillisTaskManager_Unregister(TaskFunction_t func)
 {
-    Task_t *task = MillisTaskManager_findTask(func);
+    return MillisTaskManager_UnregisterH(MillisTaskManager_findTask(func));
+}
+/**
+ * @brief  Unregister Task, the handle is invalid afterwards
+ * @param  task:handle from MillisTaskManager_register(H)
+ * @retval true if success
+ */
+bool MillisTaskManager_UnregisterH(Task_t *task)
+{
     if (task == NULL)
         return false;
-    Task_t *prev = MillisTaskManager_getPrevNode(task); // 前一个节点
-    Task_t *next = task->Next;                          // 后一个节点
-    if (prev == NULL && next != NULL)
+    MillisTaskManager_waitIdle(task);
+#if (MTM_SCHEDULER == MTM_SCHEDULER_WHEEL)
+    if (task->Slot != NULL)
     {
-        TaskManager->Head = next;
+        MillisTaskManager_listRemove(task);
+    }
+#elif (MTM_SCHEDULER == MTM_SCHEDULER_HEAP)
+    if (task->QueueIndex != 0)
+    {
+        MillisTaskManager_queueRemove(task);
+    }
+#endif
+    if (task->RunIndex != 0)
+    {
+        TaskManager->Run[task->RunIndex - 1].Task = NULL; // unregistered by a task of the running tick
     }
-    else if (prev != NULL && next == NULL)
+    Task_t *prev = task->Prev; // 前一个节点
+    Task_t *next = task->Next; // 后一个节点
+    if (prev == NULL)
     {
-        prev->Next = NULL;
+        TaskManager->Head = next;
     }
-    else if (prev != NULL && next != NULL)
+    else
     {
         prev->Next = next;
     }
+    if (next == NULL)
+    {
+        TaskManager->Tail = prev;
+    }
+    else
+    {
+        next->Prev = prev;
+    }
     TASK_DEL(task);
+    TaskManager->TaskNum--;
 
     return true;
 }
@@ -206,10 +610,20 @@ bool MillisTaskManager_Unregister(TaskFunction_t func)
  */
 bool MillisTaskManager_setTaskState(TaskFunction_t func, bool state)
 {
-    Task_t *task = MillisTaskManager_findTask(func);
+    return MillisTaskManager_setTaskStateH(MillisTaskManager_findTask(func), state);
+}
+/**
+ * @brief  Control the task state
+ * @param  task:handle
+ * @param  state:
+ * @retval true if success
+ */
+bool MillisTaskManager_setTaskStateH(Task_t *task, bool state)
+{
     if (task == NULL)
         return false;
     task->State = state;
+    MillisTaskManager_schedule(task);
     return true;
 }
 
@@ -221,36 +635,260 @@ bool MillisTaskManager_setTaskState(TaskFunction_t func, bool state)
  */
 bool MillisTaskManager_setIntervalTime(TaskFunction_t func, uint32_t timeMs)
 {
-    Task_t *task = MillisTaskManager_findTask(func);
+    return MillisTaskManager_setIntervalTimeH(MillisTaskManager_findTask(func), timeMs);
+}
+/**
+ * @brief  Config the task period
+ * @param  task:handle
+ * @param  timeMs:
+ * @retval true if success
+ */
+bool MillisTaskManager_setIntervalTimeH(Task_t *task, uint32_t timeMs)
+{
     if (task == NULL)
         return false;
 
+    MillisTaskManager_waitIdle(task); // the profile reads Time on the worker
     task->Time = timeMs;
+    MillisTaskManager_schedule(task);
     return true;
 }
 
 #if (MTM_USE_CPU_USAGE == 1)
-#include "Arduino.h"                //需要使用micros()
-static uint32_t UserFuncLoopUs = 0; // 累计时间
-/**
- * @brief  获取CPU占用率
- * @param  无
- * @retval CPU占用率，0~100%
- */
-float MillisTaskManager_GetCPU_Usage()
+#if defined(ARDUINO)
+#include "Arduino.h" //需要使用micros()
+static uint32_t MillisTaskManager_defaultClock(void)
 {
-    static uint32_t MtmStartUs;
-    float usage = (float)UserFuncLoopUs / (micros() - MtmStartUs) * 100.0f;
-
-    if (usage > 100.0f)
-        usage = 100.0f;
-
-    MtmStartUs = micros();
-    UserFuncLoopUs = 0;
-    return usage;
+    return micros();
 }
+#define MTM_DEFAULT_CLOCK MillisTaskManager_defaultClock
+#define MTM_DEFAULT_CLOCK_HZ 1000000u
+#elif defined(__unix__) || defined(__APPLE__)
+#include <time.h>
+static uint32_t MillisTaskManager_defaultClock(void)
+{
+    struct timespec ts;
+#if defined(CLOCK_MONOTONIC)
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+#else
+    timespec_get(&ts, TIME_UTC); // strict ISO C build without the POSIX clocks
+#endif
+    return (uint32_t)((uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec);
+}
+#define MTM_DEFAULT_CLOCK MillisTaskManager_defaultClock
+#define MTM_DEFAULT_CLOCK_HZ 1000000000u
+#else
+#define MTM_DEFAULT_CLOCK NULL // no stats until MillisTaskManager_setClock
+#define MTM_DEFAULT_CLOCK_HZ 0u
+#endif
+static MillisTaskClock_t TaskClock = MTM_DEFAULT_CLOCK;
+static uint32_t TaskClockHz = MTM_DEFAULT_CLOCK_HZ;
+static uint32_t TaskClockLast = 0;     // clock when TaskClockElapsed was last advanced
+static uint64_t TaskClockElapsed = 0;  // clock counts since the stats reset, survives the clock wrap
+static uint64_t UserFuncLoopStart = 0; // TaskClockElapsed at the last MillisTaskManager_GetCPU_Usage
+#if (MTM_USE_WORKER_POOL == 1)
+static atomic_ullong UserFuncLoopUs = 0; // 累计时间, summed by the workers too
+#else
+static uint64_t UserFuncLoopUs = 0; // 累计时间
 #endif
-
+/**
+ * @brief  Set the clock the task execution time is measured with, micros() and clock_gettime are the defaults
+ *         A cycle counter works as long as MillisTaskManager_Running is called once per wrap
+ * @param  clock: free running counter, NULL stops the measurement
+ * @param  clockHz: counts per second
+ * @retval 无
+ */
+void MillisTaskManager_setClock(MillisTaskClock_t clock, uint32_t clockHz)
+{
+    TaskClock = clockHz != 0 ? clock : NULL;
+    TaskClockHz = clockHz;
+    MillisTaskManager_resetStats();
+}
+/**
+ * @brief  Advance TaskClockElapsed to now
+ * @retval 无
+ */
+static void MillisTaskManager_clockAdvance(void)
+{
+    if (TaskClock != NULL)
+    {
+        uint32_t now = TaskClock();
+        TaskClockElapsed += (uint32_t)(now - TaskClockLast);
+        TaskClockLast = now;
+    }
+}
+/**
+ * @brief  Clock counts to ns
+ * @param  counts
+ * @retval ns, saturated at UINT32_MAX
+ */
+static uint32_t MillisTaskManager_clockToNs(uint64_t counts)
+{
+    if (TaskClockHz == 0)
+    {
+        return 0;
+    }
+    uint64_t ns = TaskClockHz == 1000000000u ? counts : counts * 1000000000u / TaskClockHz;
+    return ns > 0xFFFFFFFFu ? 0xFFFFFFFFu : (uint32_t)ns;
+}
+/**
+ * @brief  Log2 histogram bucket
+ * @param  value
+ * @param  bucketNum
+ * @retval 0 for 0, n for [2^(n-1), 2^n), capped at bucketNum - 1
+ */
+static uint32_t MillisTaskManager_histBucket(uint32_t value, uint32_t bucketNum)
+{
+#if defined(__GNUC__)
+    uint32_t bucket = value != 0 ? 32u - (uint32_t)__builtin_clz(value) : 0;
+#else
+    uint32_t bucket = 0;
+    for (; value != 0; value >>= 1)
+    {
+        bucket++;
+    }
+#endif
+    return bucket < bucketNum ? bucket : bucketNum - 1;
+}
+/**
+ * @brief  Record a run in the task profile
+ * @param  now: task
+ * @param  cost: clock counts
+ * @retval 无
+ */
+static void MillisTaskManager_profile(Task_t *now, uint32_t cost)
+{
+    MillisTaskProfile *profile = &now->Profile;
+    if (profile->RunCount == 0 || cost < profile->CostMin)
+    {
+        profile->CostMin = cost;
+    }
+    if (cost > profile->CostMax)
+    {
+        profile->CostMax = cost;
+    }
+    profile->RunCount++;
+    profile->CostSum += cost;
+    profile->CostHist[MillisTaskManager_histBucket(cost, MTM_STATS_COST_HIST_NUM)]++;
+    profile->JitterHist[MillisTaskManager_histBucket(now->TimeError, MTM_STATS_JITTER_HIST_NUM)]++;
+    if (now->TimeError > profile->LateMax)
+    {
+        profile->LateMax = now->TimeError;
+    }
+    if (now->Time != 0 && (uint64_t)cost * MTM_TICK_HZ > (uint64_t)now->Time * TaskClockHz)
+    {
+        profile->Overruns++; // longer than the period, the loop falls behind
+    }
+}
+/**
+ * @brief  获取CPU占用率
+ * @param  无
+ * @retval CPU占用率，0~100%, since the last call
+ */
+float MillisTaskManager_GetCPU_Usage()
+{
+    MillisTaskManager_clockAdvance();
+    uint64_t window = TaskClockElapsed - UserFuncLoopStart;
+    float usage = window != 0 ? (float)UserFuncLoopUs / window * 100.0f : 0.0f;
+
+    if (usage > 100.0f)
+        usage = 100.0f;
+
+    UserFuncLoopStart = TaskClockElapsed;
+    UserFuncLoopUs = 0;
+    return usage;
+}
+/**
+ * @brief  Get the statistics of the first task registered with a function
+ * @param  func:
+ * @param  stats: Output
+ * @retval true if success
+ */
+bool MillisTaskManager_getStats(TaskFunction_t func, MillisTaskStats *stats)
+{
+    return MillisTaskManager_getStatsH(MillisTaskManager_findTask(func), stats);
+}
+/**
+ * @brief  Get the task statistics since the last MillisTaskManager_resetStats
+ * @param  task: handle
+ * @param  stats: Output, times in ns
+ * @retval true if success
+ */
+bool MillisTaskManager_getStatsH(Task_t *task, MillisTaskStats *stats)
+{
+    if (task == NULL || stats == NULL)
+        return false;
+    MillisTaskManager_waitIdle(task); // consistent profile
+    const MillisTaskProfile *profile = &task->Profile;
+    memset(stats, 0, sizeof(MillisTaskStats));
+    stats->RunCount = profile->RunCount;
+    stats->Overruns = profile->Overruns;
+    stats->Deferrals = profile->Deferrals;
+    stats->LateMax = profile->LateMax;
+    memcpy(stats->JitterHist, profile->JitterHist, sizeof(stats->JitterHist));
+    if (profile->RunCount == 0)
+    {
+        return true;
+    }
+    stats->CostMin = MillisTaskManager_clockToNs(profile->CostMin);
+    stats->CostMax = MillisTaskManager_clockToNs(profile->CostMax);
+    stats->CostAvg = MillisTaskManager_clockToNs(profile->CostSum / profile->RunCount);
+
+    /* p99: find the bucket holding the 99th percentile run, interpolate inside it */
+    uint32_t rank = profile->RunCount - profile->RunCount / 100; // runs at or below p99
+    uint32_t below = 0;
+    for (uint32_t i = 0; i < MTM_STATS_COST_HIST_NUM; i++)
+    {
+        uint32_t count = profile->CostHist[i];
+        if (below + count >= rank)
+        {
+            uint64_t low = i == 0 ? 0 : 1ull << (i - 1);
+            uint64_t high = i == 0 ? 1 : 1ull << i;
+            uint64_t p99 = low + (high - low) * (rank - below) / count;
+            p99 = p99 < profile->CostMin ? profile->CostMin : p99;
+            p99 = p99 > profile->CostMax ? profile->CostMax : p99;
+            stats->CostP99 = MillisTaskManager_clockToNs(p99);
+            break;
+        }
+        below += count;
+    }
+
+    MillisTaskManager_clockAdvance();
+    if (TaskClockElapsed != 0)
+    {
+        stats->CpuShare = (float)profile->CostSum / TaskClockElapsed * 100.0f;
+    }
+    return true;
+}
+/**
+ * @brief  Clear the statistics of every task and restart the CPU share window
+ * @retval 无
+ */
+void MillisTaskManager_resetStats(void)
+{
+    for (Task_t *now = TaskManager != NULL ? TaskManager->Head : NULL; now != NULL; now = now->Next)
+    {
+        MillisTaskManager_waitIdle(now);
+        memset(&now->Profile, 0, sizeof(MillisTaskProfile));
+    }
+    TaskClockLast = TaskClock != NULL ? TaskClock() : 0;
+    TaskClockElapsed = 0;
+    UserFuncLoopStart = 0;
+    UserFuncLoopUs = 0;
+}
+/**
+ * @brief  Limit the task time of one MillisTaskManager_Running, the due tasks left are deferred to the next tick
+ *         and counted in their Deferrals. Needs a policy order to choose which ones run, see MillisTaskManager_setPolicy
+ *         With the worker pool only the dispatching time counts
+ * @param  budgetUs: 0 : unlimited
+ * @retval 无
+ */
+void MillisTaskManager_setTickBudget(uint32_t budgetUs)
+{
+    TaskManager->BudgetUs = budgetUs;
+}
+#endif
+
 /**
  * @brief  Time elaps
  * @param  nowTick
@@ -275,26 +913,617 @@ uint32_t MillisTaskManager_getTickElaps(uint32_t nowTick, uint32_t prevTick)
 }
 
 /**
- * @brief  Get the task time cost(us)
+ * @brief  Get the task time cost of the last run (us)
  * @param  func:
- * @retval (us)
+ * @retval (us), 0 without MTM_USE_CPU_USAGE
  */
 uint32_t MillisTaskManager_getTimeCost(TaskFunction_t func)
 {
-    Task_t *task = MillisTaskManager_findTask(func);
+    return MillisTaskManager_getTimeCostH(MillisTaskManager_findTask(func));
+}
+/**
+ * @brief  Get the task time cost of the last run (us)
+ * @param  task:handle
+ * @retval (us), 0 without MTM_USE_CPU_USAGE
+ */
+uint32_t MillisTaskManager_getTimeCostH(Task_t *task)
+{
     if (task == NULL)
         return 0;
 
+#if (MTM_USE_CPU_USAGE == 1)
+    return MillisTaskManager_clockToNs(task->TimeCost) / 1000u;
+#else
     return task->TimeCost;
+#endif
+}
+/**
+ * @brief  Order of the tasks due in the same tick
+ * @param  policy: MTM_POLICY_FIFO (default), MTM_POLICY_FIXED or MTM_POLICY_EDF
+ * @retval 无
+ */
+void MillisTaskManager_setPolicy(uint8_t policy)
+{
+    TaskManager->Policy = policy;
+}
+/**
+ * @brief  Set the task priority
+ * @param  func:
+ * @param  priority: 0 is the most urgent
+ * @retval true if success
+ */
+bool MillisTaskManager_setPriority(TaskFunction_t func, uint8_t priority)
+{
+    return MillisTaskManager_setPriorityH(MillisTaskManager_findTask(func), priority);
+}
+/**
+ * @brief  Set the task priority
+ * @param  task:handle
+ * @param  priority: 0 is the most urgent
+ * @retval true if success
+ */
+bool MillisTaskManager_setPriorityH(Task_t *task, uint8_t priority)
+{
+    if (task == NULL)
+        return false;
+    task->Priority = priority;
+    return true;
+}
+/**
+ * @brief  Walk the registered tasks, e.g. to collect their statistics
+ * @param  task: NULL for the first task
+ * @retval Next task in registration order, NULL at the end
+ */
+Task_t *MillisTaskManager_getNextTask(Task_t *task)
+{
+    if (TaskManager == NULL)
+        return NULL;
+    return task == NULL ? TaskManager->Head : task->Next;
+}
+
+/**
+ * @brief  Run a task and record its time cost
+ * @param  now: task
+ * @retval 无
+ */
+static void MillisTaskManager_execute(Task_t *now)
+{
+#if (MTM_USE_CPU_USAGE == 1)
+    MillisTaskClock_t clock = TaskClock;
+    if (clock == NULL)
+    {
+        now->Function(now->param);
+        return;
+    }
+    /*记录开始时间*/
+    uint32_t start = clock();
+
+    /*执行任务*/
+    now->Function(now->param);
+
+    /*获取执行时间*/
+    uint32_t timeCost = clock() - start;
+
+    /*记录执行时间*/
+    now->TimeCost = timeCost;
+    MillisTaskManager_profile(now, timeCost);
+
+    /*总时间累加*/
+    UserFuncLoopUs += timeCost;
+#else
+    now->Function(now->param);
+#endif
+}
+#if (MTM_USE_WORKER_POOL == 1)
+/* Work-stealing deque (Chase-Lev): the thread calling MillisTaskManager_Running pushes at the
+ * bottom, the workers steal from the top, so due tasks start in the order they were dispatched */
+typedef struct
+{
+    atomic_size_t Top;
+    atomic_size_t Bottom;
+    _Atomic(Task_t *) Buffer[MTM_POOL_DEQUE_SIZE];
+} MillisTaskDeque;
+typedef struct
+{
+    MillisTaskDeque Deque;
+    pthread_t Workers[MTM_POOL_MAX_WORKERS];
+    uint32_t WorkerNum;      // 0 : tasks run on the calling thread
+    pthread_mutex_t Lock;    // guards WakeSeq and Stop
+    pthread_cond_t Wake;
+    uint32_t WakeSeq;        // bumped when tasks are pushed while workers sleep
+    bool Stop;
+    atomic_uint Sleeping;    // workers about to wait for WakeSeq
+    uint32_t Pushed;         // tasks pushed since the last wake, calling thread only
+} MillisTaskPool;
+static MillisTaskPool TaskPool = {.Lock = PTHREAD_MUTEX_INITIALIZER, .Wake = PTHREAD_COND_INITIALIZER};
+/**
+ * @brief  Push a task at the bottom, owner side
+ * @param  task
+ * @retval false if the deque is full
+ */
+static bool MillisTaskManager_dequePush(Task_t *task)
+{
+    MillisTaskDeque *deque = &TaskPool.Deque;
+    size_t bottom = atomic_load_explicit(&deque->Bottom, memory_order_relaxed);
+    size_t top = atomic_load_explicit(&deque->Top, memory_order_acquire);
+    if (bottom - top >= MTM_POOL_DEQUE_SIZE)
+    {
+        return false;
+    }
+    atomic_store_explicit(&deque->Buffer[bottom & (MTM_POOL_DEQUE_SIZE - 1)], task, memory_order_relaxed);
+    atomic_store_explicit(&deque->Bottom, bottom + 1, memory_order_release);
+    return true;
+}
+/**
+ * @brief  Steal a task from the top, any thread
+ * @retval Task, NULL if the deque is empty
+ */
+static Task_t *MillisTaskManager_dequeSteal(void)
+{
+    MillisTaskDeque *deque = &TaskPool.Deque;
+    while (true)
+    {
+        size_t top = atomic_load_explicit(&deque->Top, memory_order_acquire);
+        atomic_thread_fence(memory_order_seq_cst);
+        size_t bottom = atomic_load_explicit(&deque->Bottom, memory_order_acquire);
+        if (top == bottom)
+        {
+            return NULL;
+        }
+        Task_t *task = atomic_load_explicit(&deque->Buffer[top & (MTM_POOL_DEQUE_SIZE - 1)], memory_order_relaxed);
+        if (atomic_compare_exchange_strong_explicit(&deque->Top, &top, top + 1, memory_order_seq_cst, memory_order_relaxed))
+        {
+            return task;
+        }
+        // Lost the race against another worker, try the next one
+    }
 }
+/**
+ * @brief  Worker thread: run stolen tasks, sleep while the deque is empty
+ * @param  arg
+ * @retval NULL
+ */
+static void *MillisTaskManager_worker(void *arg)
+{
+    (void)arg;
+    while (true)
+    {
+        pthread_mutex_lock(&TaskPool.Lock);
+        atomic_fetch_add_explicit(&TaskPool.Sleeping, 1, memory_order_seq_cst);
+        uint32_t seq = TaskPool.WakeSeq;
+        bool stop = TaskPool.Stop;
+        pthread_mutex_unlock(&TaskPool.Lock);
 
+        Task_t *task = MillisTaskManager_dequeSteal();
+        if (task != NULL)
+        {
+            atomic_fetch_sub_explicit(&TaskPool.Sleeping, 1, memory_order_relaxed);
+            MillisTaskManager_execute(task);
+            atomic_store_explicit(&task->Busy, false, memory_order_release);
+            continue;
+        }
+        pthread_mutex_lock(&TaskPool.Lock);
+        while (!stop && seq == TaskPool.WakeSeq && !TaskPool.Stop)
+        {
+            pthread_cond_wait(&TaskPool.Wake, &TaskPool.Lock);
+        }
+        atomic_fetch_sub_explicit(&TaskPool.Sleeping, 1, memory_order_relaxed);
+        pthread_mutex_unlock(&TaskPool.Lock);
+        if (stop)
+        {
+            break; // the deque was drained after the stop request
+        }
+    }
+    return NULL;
+}
+/**
+ * @brief  Wake sleeping workers once for the tasks pushed by a MillisTaskManager_Running call,
+ *         one worker per task at most. A woken worker steals until the deque is empty
+ * @retval 无
+ */
+static void MillisTaskManager_wakeWorkers(void)
+{
+    uint32_t pushed = TaskPool.Pushed;
+    if (pushed == 0)
+    {
+        return;
+    }
+    TaskPool.Pushed = 0;
+    atomic_thread_fence(memory_order_seq_cst); // pairs with the fence in MillisTaskManager_dequeSteal
+    uint32_t sleeping = atomic_load_explicit(&TaskPool.Sleeping, memory_order_relaxed);
+    if (sleeping == 0)
+    {
+        return;
+    }
+    pthread_mutex_lock(&TaskPool.Lock);
+    TaskPool.WakeSeq++;
+    if (pushed >= sleeping)
+    {
+        pthread_cond_broadcast(&TaskPool.Wake);
+    }
+    else
+    {
+        for (uint32_t i = 0; i < pushed; i++)
+        {
+            pthread_cond_signal(&TaskPool.Wake);
+        }
+    }
+    pthread_mutex_unlock(&TaskPool.Lock);
+}
+/**
+ * @brief  Start running the due tasks on a pool of worker threads
+ *         A task never runs concurrently with itself: while it is queued or running it is not
+ *         dispatched again and stays due. Task functions must not call the MillisTaskManager API
+ * @param  workerNum: 1 ~ MTM_POOL_MAX_WORKERS
+ * @retval true if success
+ */
+bool MillisTaskManager_startWorkers(uint32_t workerNum)
+{
+    if (TaskPool.WorkerNum != 0 || workerNum == 0 || workerNum > MTM_POOL_MAX_WORKERS)
+    {
+        return false;
+    }
+    TaskPool.Stop = false;
+    for (uint32_t i = 0; i < workerNum; i++)
+    {
+        if (pthread_create(&TaskPool.Workers[i], NULL, MillisTaskManager_worker, NULL) != 0)
+        {
+            MILLISTASK__ERROR("Start worker %u failed", (unsigned)i);
+            TaskPool.WorkerNum = i;
+            MillisTaskManager_stopWorkers();
+            return false;
+        }
+    }
+    TaskPool.WorkerNum = workerNum;
+    return true;
+}
+/**
+ * @brief  Run the queued tasks to the end and stop the workers, tasks run on the calling thread again
+ * @retval 无
+ */
+void MillisTaskManager_stopWorkers(void)
+{
+    if (TaskPool.WorkerNum == 0)
+    {
+        return;
+    }
+    pthread_mutex_lock(&TaskPool.Lock);
+    TaskPool.Stop = true;
+    pthread_cond_broadcast(&TaskPool.Wake);
+    pthread_mutex_unlock(&TaskPool.Lock);
+    for (uint32_t i = 0; i < TaskPool.WorkerNum; i++)
+    {
+        pthread_join(TaskPool.Workers[i], NULL);
+    }
+    TaskPool.WorkerNum = 0;
+}
+#endif
+/**
+ * @brief  Run a due task, on a worker if the pool is started
+ * @param  now: task
+ * @retval 无
+ */
+static void MillisTaskManager_dispatch(Task_t *now)
+{
+#if (MTM_USE_WORKER_POOL == 1)
+    if (TaskPool.WorkerNum != 0)
+    {
+        atomic_store_explicit(&now->Busy, true, memory_order_relaxed);
+        if (MillisTaskManager_dequePush(now))
+        {
+            TaskPool.Pushed++; // woken at the end of MillisTaskManager_Running
+            return;
+        }
+        // Deque full, run it here
+        MillisTaskManager_execute(now);
+        atomic_store_explicit(&now->Busy, false, memory_order_release);
+        return;
+    }
+#endif
+    MillisTaskManager_execute(now);
+}
+/**
+ * @brief  Check if the due tasks go through the run list, grow it to hold every task
+ * @retval false for the FIFO order without budget
+ */
+static bool MillisTaskManager_usePolicy(void)
+{
+#if (MTM_USE_CPU_USAGE == 1)
+    bool budget = TaskManager->BudgetUs != 0;
+#else
+    bool budget = false;
+#endif
+    if (TaskManager->Policy == MTM_POLICY_FIFO && !budget)
+    {
+        return false;
+    }
+    if (TaskManager->RunCapacity < TaskManager->TaskNum)
+    {
+        uint32_t capacity = TaskManager->TaskNum + TaskManager->TaskNum / 2 + 4;
+        MillisTaskRun *run = (MillisTaskRun *)__REALLOC(TaskManager->Run, capacity * sizeof(MillisTaskRun));
+        if (run == NULL)
+        {
+            MILLISTASK__ERROR("Run list of %u tasks failed, FIFO order", (unsigned)TaskManager->TaskNum);
+            return false;
+        }
+        TaskManager->Run = run;
+        TaskManager->RunCapacity = capacity;
+    }
+    TaskManager->RunNum = 0;
+    return true;
+}
+/**
+ * @brief  Add a due task to the run list
+ * @param  task
+ * @param  tick
+ * @retval 无
+ */
+static void MillisTaskManager_runAdd(Task_t *task, uint32_t tick)
+{
+    MillisTaskRun *run = &TaskManager->Run[TaskManager->RunNum];
+    // Ticks left to the deadline TimePrev + Time, negative when late
+    int64_t slack = (int64_t)task->Time - (int64_t)MillisTaskManager_getTickElaps(tick, task->TimePrev);
+    run->Task = task;
+    run->Order = TaskManager->RunNum;
+    if (TaskManager->Policy == MTM_POLICY_FIXED)
+    {
+        run->Key = ((int64_t)task->Priority << 40) + slack + (1ll << 33);
+    }
+    else if (TaskManager->Policy == MTM_POLICY_EDF)
+    {
+        run->Key = slack * 256 + task->Priority;
+    }
+    else
+    {
+        run->Key = 0; // collection order
+    }
+    TaskManager->RunNum++;
+}
+static int MillisTaskManager_runCompare(const void *a, const void *b)
+{
+    const MillisTaskRun *x = (const MillisTaskRun *)a;
+    const MillisTaskRun *y = (const MillisTaskRun *)b;
+    if (x->Key != y->Key)
+    {
+        return x->Key < y->Key ? -1 : 1;
+    }
+    return x->Order < y->Order ? -1 : (x->Order > y->Order);
+}
+/**
+ * @brief  Run the collected due tasks in policy order until the budget is used up, the others are deferred
+ *         Every task is rearmed (or put back) through MillisTaskManager_schedule before it runs
+ * @param  tick
+ * @retval 无
+ */
+static void MillisTaskManager_runDue(uint32_t tick)
+{
+    MillisTaskRun *run = TaskManager->Run;
+    uint32_t runNum = TaskManager->RunNum;
+    qsort(run, runNum, sizeof(MillisTaskRun), MillisTaskManager_runCompare);
+    for (uint32_t i = 0; i < runNum; i++)
+    {
+        run[i].Task->RunIndex = i + 1;
+    }
+#if (MTM_USE_CPU_USAGE == 1)
+    MillisTaskClock_t clock = TaskManager->BudgetUs != 0 ? TaskClock : NULL;
+    uint32_t budget = (uint32_t)((uint64_t)TaskManager->BudgetUs * TaskClockHz / 1000000u);
+    uint32_t start = clock != NULL ? clock() : 0;
+#endif
+    uint32_t ranNum = 0;
+    for (uint32_t i = 0; i < runNum; i++)
+    {
+        Task_t *now = run[i].Task;
+        if (now == NULL)
+        {
+            continue; // unregistered by a task that ran before
+        }
+        now->RunIndex = 0;
+        uint32_t elapsTime = MillisTaskManager_getTickElaps(tick, now->TimePrev);
+        if (now->Function == NULL || !now->State || elapsTime < now->Time || MillisTaskManager_isBusy(now))
+        {
+            MillisTaskManager_schedule(now); // changed by a task that ran before
+            continue;
+        }
+        /*判断是否开启优先级*/
+        bool defer = TaskManager->PriorityEnable && ranNum != 0;
+#if (MTM_USE_CPU_USAGE == 1)
+        if (!defer && clock != NULL && (uint32_t)(clock() - start) >= budget)
+        {
+            defer = true;
+        }
+        if (defer)
+        {
+            now->Profile.Deferrals++;
+        }
+#endif
+        if (defer)
+        {
+            MillisTaskManager_schedule(now); // still due, runs late next tick
+            continue;
+        }
+        /*获取时间误差，误差越大实时性越差*/
+        now->TimeError = elapsTime - now->Time;
+
+        /*记录时间点*/
+        now->TimePrev = tick;
+
+        // Rearm first, the task may unregister or reschedule itself
+        MillisTaskManager_schedule(now);
+        MillisTaskManager_dispatch(now);
+        ranNum++;
+    }
+    TaskManager->RunNum = 0;
+}
+#if (MTM_SCHEDULER == MTM_SCHEDULER_WHEEL)
+/**
+ * @brief  Schedule, only the due tasks are touched
+ *         Due tasks run in deadline order, with priority enabled one task per tick
+ * @param  tick:give the tick
+ * @retval 无
+ */
+static void MillisTaskManager_runTick(uint32_t tick)
+{
+    TaskManager->Tick = tick;
+#if (MTM_USE_CPU_USAGE == 1)
+    MillisTaskManager_clockAdvance(); // once per clock wrap at least
+#endif
+    MillisTaskManager_wheelAdvance(tick);
+    if (MillisTaskManager_usePolicy())
+    {
+        while (TaskManager->Ready != NULL)
+        {
+            Task_t *now = TaskManager->Ready;
+            MillisTaskManager_listRemove(now);
+            if (now->Function != NULL && now->State)
+            {
+                MillisTaskManager_runAdd(now, tick); // parked until setTaskState otherwise
+            }
+        }
+        MillisTaskManager_runDue(tick);
+        return;
+    }
+    // Tasks due again after running (period 0) wait for the next tick
+    TaskManager->Due = TaskManager->Ready;
+    TaskManager->Ready = NULL;
+    for (Task_t *now = TaskManager->Due; now != NULL; now = now->SlotNext)
+    {
+        now->Slot = &TaskManager->Due;
+    }
+    while (TaskManager->Due != NULL)
+    {
+        Task_t *now = TaskManager->Due;
+        MillisTaskManager_listRemove(now);
+        if (now->Function == NULL || !now->State)
+        {
+            continue; // parked until setTaskState
+        }
+        if (MillisTaskManager_isBusy(now))
+        {
+            MillisTaskManager_wheelInsert(now); // still due, retried next tick
+            continue;
+        }
+        uint32_t elapsTime = MillisTaskManager_getTickElaps(tick, now->TimePrev);
+        /*获取时间误差，误差越大实时性越差*/
+        now->TimeError = elapsTime - now->Time;
+
+        /*记录时间点*/
+        now->TimePrev = tick;
+
+        // Rearm first, the task may unregister or reschedule itself
+        MillisTaskManager_wheelInsert(now);
+        MillisTaskManager_dispatch(now);
+        /*判断是否开启优先级*/
+        if (TaskManager->PriorityEnable)
+        {
+            break;
+        }
+    }
+    // Tasks left by the priority mode stay in front of the ready list
+    if (TaskManager->Due != NULL)
+    {
+        Task_t *head = TaskManager->Due;
+        Task_t *tail = head->SlotPrev;
+        for (Task_t *now = head; now != NULL; now = now->SlotNext)
+        {
+            now->Slot = &TaskManager->Ready;
+        }
+        if (TaskManager->Ready != NULL)
+        {
+            tail->SlotNext = TaskManager->Ready;
+            head->SlotPrev = TaskManager->Ready->SlotPrev;
+            TaskManager->Ready->SlotPrev = tail;
+        }
+        TaskManager->Ready = head;
+        TaskManager->Due = NULL;
+    }
+}
+#elif (MTM_SCHEDULER == MTM_SCHEDULER_HEAP)
+/**
+ * @brief  Schedule, only the due tasks at the top of the queue are touched
+ *         Due tasks run in deadline order, with priority enabled one task per tick
+ * @param  tick:give the tick
+ * @retval 无
+ */
+static void MillisTaskManager_runTick(uint32_t tick)
+{
+    if ((int32_t)(tick - TaskManager->Tick) < 0)
+    {
+        MillisTaskManager_queueRebuild(tick); // deadlines are only comparable within 2^31 ticks
+    }
+    TaskManager->Tick = tick;
+#if (MTM_USE_CPU_USAGE == 1)
+    MillisTaskManager_clockAdvance(); // once per clock wrap at least
+#endif
+    TaskManager->Round++;
+    if (MillisTaskManager_usePolicy())
+    {
+        while (TaskManager->QueueNum != 0 && (int32_t)(tick - TaskManager->Queue[0]->Deadline) >= 0)
+        {
+            Task_t *now = TaskManager->Queue[0];
+            MillisTaskManager_queueRemove(now);
+            MillisTaskManager_runAdd(now, tick);
+        }
+        MillisTaskManager_runDue(tick);
+        return;
+    }
+    while (TaskManager->QueueNum != 0)
+    {
+        Task_t *now = TaskManager->Queue[0];
+        if ((int32_t)(tick - now->Deadline) < 0 || now->Round == TaskManager->Round)
+        {
+            break;
+        }
+        if (MillisTaskManager_isBusy(now))
+        {
+            now->Round = TaskManager->Round; // still due, retried next tick
+            now->Deadline = tick + 1;
+            MillisTaskManager_queueDown(0);
+            continue;
+        }
+        uint32_t elapsTime = MillisTaskManager_getTickElaps(tick, now->TimePrev);
+        /*获取时间误差，误差越大实时性越差*/
+        now->TimeError = elapsTime - now->Time;
+
+        /*记录时间点*/
+        now->TimePrev = tick;
+
+        // Rearm first, the task may unregister or reschedule itself
+        now->Round = TaskManager->Round;
+        now->Deadline = tick + now->Time;
+        MillisTaskManager_queueDown(0);
+        MillisTaskManager_dispatch(now);
+        /*判断是否开启优先级*/
+        if (TaskManager->PriorityEnable)
+        {
+            break;
+        }
+    }
+}
+#else
 /**
  * @brief  Schedule
  * @param  tick:give the tick
  * @retval 无
  */
-void MillisTaskManager_Running(uint32_t tick)
+static void MillisTaskManager_runTick(uint32_t tick)
 {
+    TaskManager->Tick = tick;
+#if (MTM_USE_CPU_USAGE == 1)
+    MillisTaskManager_clockAdvance(); // once per clock wrap at least
+#endif
+    if (MillisTaskManager_usePolicy())
+    {
+        for (Task_t *now = TaskManager->Head; now != NULL; now = now->Next)
+        {
+            if (now->Function != NULL && now->State && !MillisTaskManager_isBusy(now) &&
+                MillisTaskManager_getTickElaps(tick, now->TimePrev) >= now->Time)
+            {
+                MillisTaskManager_runAdd(now, tick);
+            }
+        }
+        MillisTaskManager_runDue(tick);
+        return;
+    }
     Task_t *now = TaskManager->Head;
     while (true)
     {
@@ -308,7 +1537,7 @@ void MillisTaskManager_Running(uint32_t tick)
         if (now->Function != NULL && now->State)
         {
             uint32_t elapsTime = MillisTaskManager_getTickElaps(tick, now->TimePrev);
-            if (elapsTime >= now->Time)
+            if (elapsTime >= now->Time && !MillisTaskManager_isBusy(now))
             {
                 /*获取时间误差，误差越大实时性越差*/
                 now->TimeError = elapsTime - now->Time;
@@ -316,24 +1545,7 @@ void MillisTaskManager_Running(uint32_t tick)
                 /*记录时间点*/
                 now->TimePrev = tick;
 
-#if (MTM_USE_CPU_USAGE == 1)
-                /*记录开始时间*/
-                uint32_t start = micros();
-
-                /*执行任务*/
-                now->Function();
-
-                /*获取执行时间*/
-                uint32_t timeCost = micros() - start;
-
-                /*记录执行时间*/
-                now->TimeCost = timeCost;
-
-                /*总时间累加*/
-                UserFuncLoopUs += timeCost;
-#else
-                now->Function(now->param);
-#endif
+                MillisTaskManager_dispatch(now);
 
                 /*判断是否开启优先级*/
                 if (TaskManager->PriorityEnable)
@@ -348,3 +1560,85 @@ void MillisTaskManager_Running(uint32_t tick)
         now = now->Next;
     }
 }
+#endif
+/**
+ * @brief  Schedule, run the due tasks of this tick
+ * @param  tick:give the tick
+ * @retval 无
+ */
+void MillisTaskManager_Running(uint32_t tick)
+{
+    MillisTaskManager_runTick(tick);
+#if (MTM_USE_WORKER_POOL == 1)
+    MillisTaskManager_wakeWorkers(); // once for every task pushed in this tick
+#endif
+}
+
+/**
+ * @brief  Get the tick the next task is due, to sleep or program a tickless timer until then
+ *         The heap scheduler gives the exact deadline, the timing wheel may give the tick of
+ *         an earlier cascade, the list scan walks all tasks
+ * @param  deadline: Output, the tick of the last MillisTaskManager_Running if a task is due
+ * @retval false if no task is scheduled
+ */
+bool MillisTaskManager_getNextDeadline(uint32_t *deadline)
+{
+#if (MTM_SCHEDULER == MTM_SCHEDULER_HEAP)
+    if (TaskManager->QueueNum == 0)
+    {
+        return false;
+    }
+    Task_t *next = TaskManager->Queue[0];
+    *deadline = (int32_t)(next->Deadline - TaskManager->Tick) > 0 ? next->Deadline : TaskManager->Tick;
+    return true;
+#elif (MTM_SCHEDULER == MTM_SCHEDULER_WHEEL)
+    if (TaskManager->Ready != NULL)
+    {
+        *deadline = TaskManager->WheelTick;
+        return true;
+    }
+    bool found = false;
+    uint32_t nearest = 0;
+    for (uint8_t level = 0; level < MTM_WHEEL_LEVEL_NUM; level++)
+    {
+        uint32_t shift = MTM_WHEEL_SLOT_LOG2 * level;
+        uint32_t bitmap = TaskManager->WheelBitmap[level];
+        // First non-empty slot after the current one, a level n slot is handled at its cascade
+        for (uint32_t i = 1; bitmap != 0 && i <= MTM_WHEEL_SLOT_NUM; i++)
+        {
+            uint32_t index = (TaskManager->WheelTick >> shift) + i;
+            if (bitmap & (1u << (index & (MTM_WHEEL_SLOT_NUM - 1))))
+            {
+                uint32_t ticks = (index << shift) - TaskManager->WheelTick;
+                if (!found || ticks < nearest)
+                {
+                    nearest = ticks;
+                }
+                found = true;
+                break;
+            }
+        }
+    }
+    *deadline = TaskManager->WheelTick + nearest;
+    return found;
+#else
+    bool found = false;
+    uint32_t nearest = 0;
+    for (Task_t *now = TaskManager->Head; now != NULL; now = now->Next)
+    {
+        if (now->Function == NULL || !now->State)
+        {
+            continue;
+        }
+        uint32_t elapsTime = MillisTaskManager_getTickElaps(TaskManager->Tick, now->TimePrev);
+        uint32_t ticks = elapsTime >= now->Time ? 0 : now->Time - elapsTime;
+        if (!found || ticks < nearest)
+        {
+            nearest = ticks;
+        }
+        found = true;
+    }
+    *deadline = TaskManager->Tick + nearest;
+    return found;
+#endif
+}
@@ -9,6 +9,40 @@ extern "C"
 #include <string.h>
 #define HEAP_MANAGER_USE_LOG 1
 
+/* Scheduler */
+#define MTM_SCHEDULER_LIST 0  // every tick checks every task
+#define MTM_SCHEDULER_WHEEL 1 // hierarchical timing wheel, a tick only touches the due tasks
+#define MTM_SCHEDULER_HEAP 2  // binary min-heap on TimePrev + Time, exact next deadline for tickless sleep
+#ifndef MTM_SCHEDULER
+#define MTM_SCHEDULER MTM_SCHEDULER_LIST
+#endif
+#define MTM_WHEEL_SLOT_LOG2 5 // 32 slots per level
+#define MTM_WHEEL_SLOT_NUM (1u << MTM_WHEEL_SLOT_LOG2)
+#define MTM_WHEEL_LEVEL_NUM 4 // 1 << 20 ticks, longer periods are cascaded again
+
+/* Order of the tasks due in the same tick, see MillisTaskManager_setPolicy */
+#define MTM_POLICY_FIFO 0  // list order (list scan) or deadline order (wheel, heap)
+#define MTM_POLICY_FIXED 1 // Priority first, then the earliest deadline
+#define MTM_POLICY_EDF 2   // earliest deadline first, then Priority
+
+/* Worker pool for hosted builds (needs pthread and C11 atomics), see MillisTaskManager_startWorkers */
+#ifndef MTM_USE_WORKER_POOL
+#define MTM_USE_WORKER_POOL 0
+#endif
+#define MTM_POOL_MAX_WORKERS 16
+#define MTM_POOL_DEQUE_SIZE 1024 // tasks waiting for a worker, power of 2
+#if (MTM_USE_WORKER_POOL == 1)
+#include <stdatomic.h>
+#endif
+
+/* Per-task execution time statistics from a clock hook, see MillisTaskManager_setClock */
+#ifndef MTM_USE_CPU_USAGE
+#define MTM_USE_CPU_USAGE 0
+#endif
+#define MTM_TICK_HZ 1000             // ticks given to MillisTaskManager_Running per second, for the overruns
+#define MTM_STATS_COST_HIST_NUM 32   // log2 buckets of the execution time in clock counts
+#define MTM_STATS_JITTER_HIST_NUM 8  // log2 buckets of TimeError: 0, 1, 2~3, 4~7 ... ticks
+
 #if (HEAP_MANAGER_USE_LOG == 1)
 #include <stdio.h>
 #define _MILLISTASK_LOG(format, ...) printf("[TASK MANAGER]" format "\r\n", ##__VA_ARGS__)
@@ -16,12 +50,39 @@ extern "C"
 #define MILLISTASK__WARN(format, ...) _MILLISTASK_LOG("[Warn] " format, ##__VA_ARGS__)
 #define MILLISTASK__ERROR(format, ...) _MILLISTASK_LOG("[Error] " format, ##__VA_ARGS__)
 #else
-#define HEAP_MANAGER_INFO(...)
-#define HEAP_MANAGER_INFO(...)
-#define HEAP_MANAGER_WARN(...)
-#define HEAP_MANAGER_ERROR(...)
+#define MILLISTASK__INFO(...)
+#define MILLISTASK__WARN(...)
+#define MILLISTASK__ERROR(...)
 #endif
     typedef void (*TaskFunction_t)(void *); // 任务回调函数
+#if (MTM_USE_CPU_USAGE == 1)
+    typedef uint32_t (*MillisTaskClock_t)(void); // free running counter, wraps at 2^32
+    typedef struct
+    {
+        uint32_t RunCount;                               // runs since the last reset
+        uint32_t CostMin;                                // clock counts
+        uint32_t CostMax;
+        uint32_t Overruns;                               // runs longer than the period
+        uint32_t Deferrals;                              // due but put off by the tick budget or the priority mode
+        uint32_t LateMax;                                // max TimeError (ticks)
+        uint64_t CostSum;
+        uint32_t CostHist[MTM_STATS_COST_HIST_NUM];      // bucket n : [2^(n-1), 2^n) counts
+        uint32_t JitterHist[MTM_STATS_JITTER_HIST_NUM];  // bucket n : [2^(n-1), 2^n) ticks late
+    } MillisTaskProfile;
+    typedef struct
+    {
+        uint32_t RunCount;
+        uint32_t CostMin;  // execution time (ns)
+        uint32_t CostAvg;
+        uint32_t CostMax;
+        uint32_t CostP99;  // estimated inside its histogram bucket
+        uint32_t Overruns; // runs longer than the period
+        uint32_t Deferrals; // due but put off by the tick budget or the priority mode
+        uint32_t LateMax;  // max start delay (ticks)
+        uint32_t JitterHist[MTM_STATS_JITTER_HIST_NUM]; // start delay (TimeError): 0, 1, 2~3, 4~7 ... ticks
+        float CpuShare;    // 0 ~ 100%, of the time since the last reset
+    } MillisTaskStats;
+#endif
     typedef struct _Task
     {
         bool State;              // Task state
@@ -29,22 +90,96 @@ extern "C"
         TaskFunction_t Function; // Task handle
         uint32_t Time;           // Task period
         uint32_t TimePrev;       // Task last run time
-        uint32_t TimeCost;       // Task time cost (us)
+        uint32_t TimeCost;       // Task time cost of the last run (clock counts)
         uint32_t TimeError;      // Time error
         struct _Task *Next;      // Next node
+        struct _Task *Prev;      // Prev node, unlinked in O(1)
+        uint8_t Priority;        // 0 is the most urgent, MTM_POLICY_FIXED / MTM_POLICY_EDF
+        uint32_t RunIndex;       // position in the run list + 1, 0 if not in it
+#if (MTM_SCHEDULER == MTM_SCHEDULER_WHEEL)
+        struct _Task *SlotPrev;  // Head: tail of the list
+        struct _Task *SlotNext;  // Next node in the same slot
+        struct _Task **Slot;     // Wheel slot or ready list, NULL if not scheduled
+#elif (MTM_SCHEDULER == MTM_SCHEDULER_HEAP)
+        uint32_t Deadline;       // TimePrev + Time, due ticks are kept as they are
+        uint32_t Round;          // MillisTaskManager_Running call it last ran in
+        uint32_t QueueIndex;     // position in the queue + 1, 0 if not scheduled
+#endif
+#if (MTM_USE_CPU_USAGE == 1)
+        MillisTaskProfile Profile;
+#endif
+#if (MTM_USE_WORKER_POOL == 1)
+        atomic_bool Busy;        // queued or running on a worker, never dispatched twice
+#endif
     } Task_t;
+    typedef struct
+    {
+        Task_t *Task;   // NULL if unregistered while waiting to run
+        int64_t Key;    // sort key of the policy
+        uint32_t Order; // collection order, ties
+    } MillisTaskRun;
     typedef struct _MillisTaskManager
     {
         Task_t *Head;        // Node head
         Task_t *Tail;        // node tail
         bool PriorityEnable; // Priority
+        uint32_t TaskNum;    // registered tasks
+        uint32_t Tick;       // tick of the last MillisTaskManager_Running
+        uint8_t Policy;      // MTM_POLICY_*
+        MillisTaskRun *Run;  // due tasks of the running tick, MTM_POLICY_FIXED / MTM_POLICY_EDF / budget
+        uint32_t RunNum;
+        uint32_t RunCapacity;
+#if (MTM_USE_CPU_USAGE == 1)
+        uint32_t BudgetUs;   // task time per MillisTaskManager_Running, 0 : unlimited
+#endif
+#if (MTM_SCHEDULER == MTM_SCHEDULER_WHEEL)
+        uint32_t WheelTick;                                       // tick the wheel has been advanced to
+        uint32_t WheelBitmap[MTM_WHEEL_LEVEL_NUM];                // non-empty slots of each level
+        Task_t *Wheel[MTM_WHEEL_LEVEL_NUM][MTM_WHEEL_SLOT_NUM];   // level n slot covers 32^n ticks
+        Task_t *Ready;                                            // due tasks, in deadline order
+        Task_t *Due;                                              // ready tasks taken by the running tick
+#elif (MTM_SCHEDULER == MTM_SCHEDULER_HEAP)
+        Task_t **Queue;         // binary min-heap on Deadline
+        uint32_t QueueNum;      // scheduled tasks
+        uint32_t QueueCapacity; // grown with the registered tasks
+        uint32_t Round;         // MillisTaskManager_Running calls
+#endif
     } MillisTaskManager;
 
 
 void MillisTaskManager_Init(bool priorityEnable);
+void MillisTaskManager_DeInit();
 
 Task_t* MillisTaskManager_register(TaskFunction_t func, uint32_t timeMs, bool state,void *param);
+bool MillisTaskManager_Unregister(TaskFunction_t func);
+bool MillisTaskManager_setTaskState(TaskFunction_t func, bool state);
+bool MillisTaskManager_setIntervalTime(TaskFunction_t func, uint32_t timeMs);
+uint32_t MillisTaskManager_getTimeCost(TaskFunction_t func);
+/* Handle API: O(1), the same function may be registered several times */
+Task_t* MillisTaskManager_registerH(TaskFunction_t func, uint32_t timeMs, bool state, void *param);
+bool MillisTaskManager_UnregisterH(Task_t *task);
+bool MillisTaskManager_setTaskStateH(Task_t *task, bool state);
+bool MillisTaskManager_setIntervalTimeH(Task_t *task, uint32_t timeMs);
+uint32_t MillisTaskManager_getTimeCostH(Task_t *task);
+Task_t* MillisTaskManager_getNextTask(Task_t *task);
+void MillisTaskManager_setPolicy(uint8_t policy);
+bool MillisTaskManager_setPriority(TaskFunction_t func, uint8_t priority);
+bool MillisTaskManager_setPriorityH(Task_t *task, uint8_t priority);
+uint32_t MillisTaskManager_getTickElaps(uint32_t nowTick, uint32_t prevTick);
 void MillisTaskManager_Running(uint32_t tick);
+bool MillisTaskManager_getNextDeadline(uint32_t *deadline);
+#if (MTM_USE_CPU_USAGE == 1)
+void MillisTaskManager_setClock(MillisTaskClock_t clock, uint32_t clockHz);
+float MillisTaskManager_GetCPU_Usage();
+bool MillisTaskManager_getStats(TaskFunction_t func, MillisTaskStats *stats);
+bool MillisTaskManager_getStatsH(Task_t *task, MillisTaskStats *stats);
+void MillisTaskManager_resetStats(void);
+void MillisTaskManager_setTickBudget(uint32_t budgetUs);
+#endif
+#if (MTM_USE_WORKER_POOL == 1)
+bool MillisTaskManager_startWorkers(uint32_t workerNum);
+void MillisTaskManager_stopWorkers(void);
+#endif
 
 #ifdef __cplusplus
 }
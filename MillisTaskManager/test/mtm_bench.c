@@ -0,0 +1,401 @@
+/*
+ * \file   mtm_bench.c
+ * \brief  MillisTaskManager benchmarks
+ *
+ * - Build (hosted):
+ *     gcc -O2 -I.. -I../../HeapManager mtm_bench.c ../MillisTaskManager.c ../../HeapManager/HeapManager.c -o mtm_bench
+ *   Add -DMTM_SCHEDULER=1 for the timing wheel, -DMTM_SCHEDULER=2 for the min-heap,
+ *   the default is the list scan.
+ *   Add -pthread -DMTM_USE_WORKER_POOL=1 for the serial vs worker pool comparison, it needs
+ *   a core per worker plus one for the MillisTaskManager_Running thread (5 for 4 workers),
+ *   with fewer cores the workers only time-slice with the calling thread.
+ *   -DMTM_USE_CPU_USAGE=1 for the per-task statistics and the overload simulation.
+ */
+#include "HeapManager.h"
+#include "MillisTaskManager.h"
+#include <stdio.h>
+#include <time.h>
+#if (MTM_USE_WORKER_POOL == 1)
+#include <stdatomic.h>
+#include <unistd.h>
+#endif
+
+#define BENCH_HEAP_SIZE (4 * 1024 * 1024)
+#define BENCH_TASK_NUM 10000
+#define BENCH_TICKS 10000
+
+static uint8_t heap_buffer[BENCH_HEAP_SIZE];
+static uint32_t bench_runs = 0;
+static const uint32_t bench_periods_mixed[] = {1, 5, 10, 20, 50, 100, 200, 500, 1000, 2000, 5000, 10000, 30000, 60000};
+static const uint32_t bench_periods_slow[] = {100, 200, 500, 1000, 2000, 5000, 10000, 30000, 60000}; // mostly idle ticks
+
+static void bench_task(void *param)
+{
+    (void)param;
+    bench_runs++;
+}
+static void bench_task_last(void *param)
+{
+    (void)param;
+}
+
+static uint64_t bench_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+/**
+ * @brief  Per-tick scheduling cost: BENCH_TASK_NUM periodic tasks, periods taken round robin,
+ *         MillisTaskManager_Running called on every tick for BENCH_TICKS ticks
+ * @param  name
+ * @param  periods
+ * @param  periodNum
+ */
+static void bench_periodic_tasks(const char *name, const uint32_t *periods, uint32_t periodNum)
+{
+    heap_mgr_init(heap_buffer, BENCH_HEAP_SIZE, NULL, NULL);
+    MillisTaskManager_Init(false);
+    for (uint32_t i = 0; i < BENCH_TASK_NUM; i++)
+    {
+        Task_t *task = MillisTaskManager_registerH(bench_task, periods[i % periodNum], true, NULL);
+        if (task == NULL)
+        {
+            printf("%s periods: register %u failed\n", name, i);
+            return;
+        }
+    }
+    // First tick runs every task once (TimePrev is 0), keep it out of the measurement
+    MillisTaskManager_Running(0x10000);
+    bench_runs = 0;
+    uint64_t start = bench_now_ns();
+    for (uint32_t tick = 1; tick <= BENCH_TICKS; tick++)
+    {
+        MillisTaskManager_Running(0x10000 + tick);
+    }
+    uint64_t ns = bench_now_ns() - start;
+    printf("%s periods (%d tasks, %d ticks, scheduler=%d): %.2f us/tick, %.1f runs/tick\n",
+           name, BENCH_TASK_NUM, BENCH_TICKS, MTM_SCHEDULER, ns / 1000.0 / BENCH_TICKS, (double)bench_runs / BENCH_TICKS);
+    MillisTaskManager_DeInit();
+}
+/**
+ * @brief  Tickless loop: sleep until MillisTaskManager_getNextDeadline instead of polling every tick,
+ *         wakeups and scheduling cost for the same BENCH_TICKS ticks
+ * @param  name
+ * @param  periods
+ * @param  periodNum
+ */
+static void bench_tickless(const char *name, const uint32_t *periods, uint32_t periodNum)
+{
+    heap_mgr_init(heap_buffer, BENCH_HEAP_SIZE, NULL, NULL);
+    MillisTaskManager_Init(false);
+    for (uint32_t i = 0; i < BENCH_TASK_NUM; i++)
+    {
+        MillisTaskManager_registerH(bench_task, periods[i % periodNum], true, NULL);
+    }
+    MillisTaskManager_Running(0x10000);
+    bench_runs = 0;
+    uint32_t wakeups = 0;
+    uint32_t tick = 0x10000;
+    uint64_t start = bench_now_ns();
+    while (tick - 0x10000 < BENCH_TICKS)
+    {
+        uint32_t deadline = 0;
+        if (!MillisTaskManager_getNextDeadline(&deadline))
+        {
+            break;
+        }
+        tick = deadline != tick ? deadline : tick + 1; // a due task made no progress in the last call
+        MillisTaskManager_Running(tick);
+        wakeups++;
+    }
+    uint64_t ns = bench_now_ns() - start;
+    printf("%s periods tickless (%d tasks, %d ticks, scheduler=%d): %u wakeups, %.2f us/wakeup, %.1f runs/tick\n",
+           name, BENCH_TASK_NUM, BENCH_TICKS, MTM_SCHEDULER, wakeups, ns / 1000.0 / wakeups, (double)bench_runs / BENCH_TICKS);
+    MillisTaskManager_DeInit();
+}
+
+/**
+ * @brief  Control operation cost: setIntervalTime by function (list scan) vs by handle,
+ *         on the last of BENCH_TASK_NUM registered tasks
+ */
+static void bench_control_ops(void)
+{
+    heap_mgr_init(heap_buffer, BENCH_HEAP_SIZE, NULL, NULL);
+    MillisTaskManager_Init(false);
+    for (uint32_t i = 0; i < BENCH_TASK_NUM; i++)
+    {
+        MillisTaskManager_registerH(bench_task, bench_periods_mixed[i % (sizeof(bench_periods_mixed) / sizeof(bench_periods_mixed[0]))], true, NULL);
+    }
+    Task_t *last = MillisTaskManager_register(bench_task_last, 1000, true, NULL);
+    uint64_t start = bench_now_ns();
+    for (uint32_t i = 0; i < BENCH_TASK_NUM; i++)
+    {
+        MillisTaskManager_setIntervalTime(bench_task_last, 1000 + (i & 7));
+    }
+    uint64_t byFunc = bench_now_ns() - start;
+    start = bench_now_ns();
+    for (uint32_t i = 0; i < BENCH_TASK_NUM; i++)
+    {
+        MillisTaskManager_setIntervalTimeH(last, 1000 + (i & 7));
+    }
+    uint64_t byHandle = bench_now_ns() - start;
+    printf("setIntervalTime (%d tasks, scheduler=%d): by function %.1f ns/op, by handle %.1f ns/op\n",
+           BENCH_TASK_NUM + 1, MTM_SCHEDULER, (double)byFunc / BENCH_TASK_NUM, (double)byHandle / BENCH_TASK_NUM);
+    MillisTaskManager_DeInit();
+}
+
+#if (MTM_USE_CPU_USAGE == 1)
+#define BENCH_STATS_MS 1000
+static volatile uint32_t bench_stats_sink;
+static void bench_stats_work(void *param)
+{
+    // param : loop count, every 64th run of the 0 task takes ~15 ms
+    static uint32_t spikeRuns = 0;
+    uint32_t loops = (uint32_t)(uintptr_t)param;
+    if (loops == 0 && (++spikeRuns & 63) == 0)
+    {
+        loops = 6000000;
+    }
+    for (uint32_t i = 0; i < loops; i++)
+    {
+        bench_stats_sink += i;
+    }
+}
+/**
+ * @brief  Per-task statistics: a few tasks with different loads in a real time loop,
+ *         tick = ms since start, then the stats API finds the one stealing the loop
+ */
+static void bench_task_stats(void)
+{
+    static const uint32_t loops[] = {100, 1000, 10000, 0};
+    static const uint32_t periods[] = {1, 5, 10, 10};
+    heap_mgr_init(heap_buffer, BENCH_HEAP_SIZE, NULL, NULL);
+    MillisTaskManager_Init(false);
+    for (uint32_t i = 0; i < sizeof(loops) / sizeof(loops[0]); i++)
+    {
+        MillisTaskManager_registerH(bench_stats_work, periods[i], true, (void *)(uintptr_t)loops[i]);
+    }
+    MillisTaskManager_resetStats();
+    uint64_t start = bench_now_ns();
+    uint32_t tick = 0;
+    while (tick < BENCH_STATS_MS)
+    {
+        tick = (uint32_t)((bench_now_ns() - start) / 1000000ull);
+        MillisTaskManager_Running(tick);
+    }
+    printf("task stats (scheduler=%d), loop usage %.1f%%\n", MTM_SCHEDULER, MillisTaskManager_GetCPU_Usage());
+    printf("  period  runs      min      avg      p99      max (ns)  overruns  cpu%%  late 0/1/2~3/4~7+ ticks\n");
+    for (Task_t *task = MillisTaskManager_getNextTask(NULL); task != NULL; task = MillisTaskManager_getNextTask(task))
+    {
+        MillisTaskStats stats;
+        MillisTaskManager_getStatsH(task, &stats);
+        uint32_t late4 = 0;
+        for (uint32_t i = 3; i < MTM_STATS_JITTER_HIST_NUM; i++)
+        {
+            late4 += stats.JitterHist[i];
+        }
+        printf("  %6u %5u %8u %8u %8u %8u %9u %5.1f  %u/%u/%u/%u\n", (unsigned)task->Time, (unsigned)stats.RunCount,
+               (unsigned)stats.CostMin, (unsigned)stats.CostAvg, (unsigned)stats.CostP99, (unsigned)stats.CostMax,
+               (unsigned)stats.Overruns, stats.CpuShare,
+               (unsigned)stats.JitterHist[0], (unsigned)stats.JitterHist[1], (unsigned)stats.JitterHist[2], (unsigned)late4);
+    }
+    MillisTaskManager_DeInit();
+}
+
+/* Overload simulation: tasks advance a simulated us clock by their cost, tick = sim ms */
+#define BENCH_SIM_MS 20000
+#define BENCH_SIM_CLASS_NUM 3
+typedef struct
+{
+    uint32_t Cost;   // us per run
+    uint32_t Period; // ms
+    uint8_t Class;   // priority
+} BenchSimSpec;
+typedef struct
+{
+    Task_t *Task;
+    const BenchSimSpec *Spec;
+    uint32_t OnTime; // runs started before the next release
+} BenchSimTask;
+static const BenchSimSpec bench_sim_specs[] = {
+    // 132% load, registered low priority first so the list order is the worst one
+    {1200, 20, 2}, {1200, 20, 2}, {1200, 20, 2}, {1200, 20, 2}, {1200, 20, 2},
+    {1200, 20, 2}, {1200, 20, 2}, {1200, 20, 2}, {1200, 20, 2}, {1200, 20, 2},
+    {500, 10, 1}, {500, 10, 1}, {500, 10, 1}, {500, 10, 1}, {500, 10, 1}, {500, 10, 1}, {500, 10, 1}, {500, 10, 1},
+    {400, 5, 0}, {400, 5, 0}, {400, 5, 0}, {400, 5, 0}};
+#define BENCH_SIM_TASK_NUM (sizeof(bench_sim_specs) / sizeof(bench_sim_specs[0]))
+static BenchSimTask bench_sim_tasks[BENCH_SIM_TASK_NUM];
+static uint32_t bench_sim_us;
+static uint32_t bench_sim_clock(void)
+{
+    return bench_sim_us;
+}
+static void bench_sim_run(void *param)
+{
+    BenchSimTask *sim = (BenchSimTask *)param;
+    bench_sim_us += sim->Spec->Cost;
+    if (sim->Task->TimeError < sim->Task->Time)
+    {
+        sim->OnTime++;
+    }
+}
+/**
+ * @brief  Deadline misses under overload: a release is missed unless its run starts before the next release
+ * @param  name
+ * @param  policy: MTM_POLICY_*
+ * @param  priorityEnable: the old one task per tick mode
+ * @param  budgetUs: per tick, 0 : unlimited
+ */
+static void bench_overload(const char *name, uint8_t policy, bool priorityEnable, uint32_t budgetUs)
+{
+    heap_mgr_init(heap_buffer, BENCH_HEAP_SIZE, NULL, NULL);
+    MillisTaskManager_Init(priorityEnable);
+    MillisTaskManager_setClock(bench_sim_clock, 1000000);
+    MillisTaskManager_setPolicy(policy);
+    MillisTaskManager_setTickBudget(budgetUs);
+    bench_sim_us = 0;
+    for (uint32_t i = 0; i < BENCH_SIM_TASK_NUM; i++)
+    {
+        bench_sim_tasks[i].Spec = &bench_sim_specs[i];
+        bench_sim_tasks[i].OnTime = 0;
+        bench_sim_tasks[i].Task = MillisTaskManager_registerH(bench_sim_run, bench_sim_specs[i].Period, true, &bench_sim_tasks[i]);
+        MillisTaskManager_setPriorityH(bench_sim_tasks[i].Task, bench_sim_specs[i].Class);
+        bench_sim_tasks[i].Task->TimePrev = 0; // first release at tick period
+    }
+    while (bench_sim_us < BENCH_SIM_MS * 1000u)
+    {
+        uint32_t tick = bench_sim_us / 1000;
+        uint32_t before = bench_sim_us;
+        MillisTaskManager_Running(tick);
+        if (bench_sim_us == before)
+        {
+            bench_sim_us = (tick + 1) * 1000; // idle until the next tick
+        }
+    }
+    uint32_t releases[BENCH_SIM_CLASS_NUM] = {0};
+    uint32_t onTime[BENCH_SIM_CLASS_NUM] = {0};
+    uint32_t lateMax[BENCH_SIM_CLASS_NUM] = {0};
+    for (uint32_t i = 0; i < BENCH_SIM_TASK_NUM; i++)
+    {
+        MillisTaskStats stats;
+        MillisTaskManager_getStatsH(bench_sim_tasks[i].Task, &stats);
+        uint8_t cls = bench_sim_specs[i].Class;
+        releases[cls] += BENCH_SIM_MS / bench_sim_specs[i].Period;
+        onTime[cls] += bench_sim_tasks[i].OnTime;
+        lateMax[cls] = stats.LateMax > lateMax[cls] ? stats.LateMax : lateMax[cls];
+    }
+    printf("  %-22s", name);
+    for (uint32_t cls = 0; cls < BENCH_SIM_CLASS_NUM; cls++)
+    {
+        printf("  prio %u: %5.1f%% miss, late max %5u ms", (unsigned)cls,
+               100.0 - 100.0 * onTime[cls] / releases[cls], (unsigned)lateMax[cls]);
+    }
+    printf("\n");
+    MillisTaskManager_DeInit();
+}
+#endif
+
+#if (MTM_USE_WORKER_POOL == 1)
+#define BENCH_POOL_MS 2000
+#define BENCH_POOL_SLOW_NUM 4    // 3 ms of work every 20 ms each
+#define BENCH_POOL_PROBE_NUM 256 // 1 ms period, measure how late they start
+static uint64_t bench_pool_start;
+static Task_t *bench_pool_probes[BENCH_POOL_PROBE_NUM];
+static atomic_uint bench_pool_slow_runs;
+static atomic_uint bench_pool_probe_runs;
+static atomic_ullong bench_pool_late_sum;
+static atomic_ullong bench_pool_late_max;
+static void bench_pool_spin(uint64_t ns)
+{
+    uint64_t end = bench_now_ns() + ns;
+    while (bench_now_ns() < end)
+    {
+    }
+}
+static void bench_pool_slow(void *param)
+{
+    (void)param;
+    bench_pool_spin(3000000);
+    atomic_fetch_add_explicit(&bench_pool_slow_runs, 1, memory_order_relaxed);
+}
+static void bench_pool_probe(void *param)
+{
+    Task_t *task = bench_pool_probes[(uintptr_t)param];
+    // The tick the probe was dispatched on starts TimePrev ms after bench_pool_start
+    uint64_t due = bench_pool_start + (uint64_t)task->TimePrev * 1000000ull;
+    uint64_t now = bench_now_ns();
+    uint64_t late = now > due ? now - due : 0;
+    atomic_fetch_add_explicit(&bench_pool_late_sum, late, memory_order_relaxed);
+    uint64_t max = atomic_load_explicit(&bench_pool_late_max, memory_order_relaxed);
+    while (late > max && !atomic_compare_exchange_weak_explicit(&bench_pool_late_max, &max, late, memory_order_relaxed, memory_order_relaxed))
+    {
+    }
+    atomic_fetch_add_explicit(&bench_pool_probe_runs, 1, memory_order_relaxed);
+}
+/**
+ * @brief  Serial vs worker pool: a few heavy tasks block the calling thread in serial mode and
+ *         delay every light task behind them; real time, tick = ms since start
+ * @param  workerNum: 0 runs every task on the calling thread
+ */
+static void bench_worker_pool(uint32_t workerNum)
+{
+    heap_mgr_init(heap_buffer, BENCH_HEAP_SIZE, NULL, NULL);
+    MillisTaskManager_Init(false);
+    for (uint32_t i = 0; i < BENCH_POOL_SLOW_NUM; i++)
+    {
+        MillisTaskManager_registerH(bench_pool_slow, 20, true, NULL);
+    }
+    for (uintptr_t i = 0; i < BENCH_POOL_PROBE_NUM; i++)
+    {
+        bench_pool_probes[i] = MillisTaskManager_registerH(bench_pool_probe, 1, true, (void *)i);
+    }
+    atomic_store(&bench_pool_slow_runs, 0);
+    atomic_store(&bench_pool_probe_runs, 0);
+    atomic_store(&bench_pool_late_sum, 0);
+    atomic_store(&bench_pool_late_max, 0);
+    if (workerNum != 0 && !MillisTaskManager_startWorkers(workerNum))
+    {
+        printf("worker pool: start %u workers failed\n", workerNum);
+        return;
+    }
+    bench_pool_start = bench_now_ns();
+    uint32_t tick = 0;
+    while (tick < BENCH_POOL_MS)
+    {
+        tick = (uint32_t)((bench_now_ns() - bench_pool_start) / 1000000ull);
+        MillisTaskManager_Running(tick);
+    }
+    MillisTaskManager_stopWorkers();
+    uint32_t probeRuns = atomic_load(&bench_pool_probe_runs);
+    printf("worker pool (%u workers, %ld cores, scheduler=%d): %.0f runs/s, slow %u/%u runs, probe %u/%u runs, probe late avg %.1f us max %.1f us\n",
+           workerNum, sysconf(_SC_NPROCESSORS_ONLN), MTM_SCHEDULER, (atomic_load(&bench_pool_slow_runs) + probeRuns) * 1000.0 / BENCH_POOL_MS,
+           atomic_load(&bench_pool_slow_runs), BENCH_POOL_SLOW_NUM * BENCH_POOL_MS / 20,
+           probeRuns, BENCH_POOL_PROBE_NUM * BENCH_POOL_MS,
+           probeRuns ? atomic_load(&bench_pool_late_sum) / 1000.0 / probeRuns : 0.0, atomic_load(&bench_pool_late_max) / 1000.0);
+    MillisTaskManager_DeInit();
+}
+#endif
+
+int main(void)
+{
+    bench_periodic_tasks("mixed", bench_periods_mixed, sizeof(bench_periods_mixed) / sizeof(bench_periods_mixed[0]));
+    bench_periodic_tasks("slow", bench_periods_slow, sizeof(bench_periods_slow) / sizeof(bench_periods_slow[0]));
+    bench_tickless("slow", bench_periods_slow, sizeof(bench_periods_slow) / sizeof(bench_periods_slow[0]));
+    bench_control_ops();
+#if (MTM_USE_CPU_USAGE == 1)
+    bench_task_stats();
+    printf("overload simulation (%u tasks, 132%% load, %d ms, scheduler=%d)\n", (unsigned)BENCH_SIM_TASK_NUM, BENCH_SIM_MS, MTM_SCHEDULER);
+    bench_overload("fifo", MTM_POLICY_FIFO, false, 0);
+    bench_overload("fifo one per tick", MTM_POLICY_FIFO, true, 0);
+    bench_overload("fixed", MTM_POLICY_FIXED, false, 0);
+    bench_overload("fixed, 1 ms budget", MTM_POLICY_FIXED, false, 1000);
+    bench_overload("edf", MTM_POLICY_EDF, false, 0);
+    bench_overload("edf, 1 ms budget", MTM_POLICY_EDF, false, 1000);
+#endif
+#if (MTM_USE_WORKER_POOL == 1)
+    bench_worker_pool(0);
+    bench_worker_pool(4);
+#endif
+    return 0;
+}
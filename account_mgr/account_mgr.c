@@ -173,10 +173,20 @@ bool account_mgr_publish(const char *publisher, void *data, size_t len)
     }
 
     // Make a copy of subscriber list to avoid executing callbacks under mutex
-    subscriber_node_t *sub_copy_head = NULL;
+    // All copies come from one arena chunk, released with a single free
+    uint32_t sub_count = 0;
     subscriber_node_t *sub = pub_node->subscribers;
     while (sub) {
-        subscriber_node_t *n = (subscriber_node_t *)__CALLOC(1, sizeof(subscriber_node_t));
+        sub_count++;
+        sub = sub->next;
+    }
+    __ARENA_T arena = {0};
+    if (sub_count) __ARENA_INIT(&arena, sub_count * sizeof(subscriber_node_t));
+
+    subscriber_node_t *sub_copy_head = NULL;
+    sub = pub_node->subscribers;
+    while (sub) {
+        subscriber_node_t *n = (subscriber_node_t *)__ARENA_ALLOC(&arena, sizeof(subscriber_node_t));
         if (!n) break;
         n->name = sub->name; // shallow copy, safe
         n->cb = sub->cb;
@@ -194,10 +204,9 @@ bool account_mgr_publish(const char *publisher, void *data, size_t len)
         if (sub->cb) {
             sub->cb(publisher, data, len, sub->user_ctx);
         }
-        subscriber_node_t *tmp = sub;
         sub = sub->next;
-        __FREE(tmp); // __FREE temporary node, not the name
     }
+    __ARENA_DESTROY(&arena); // temporary nodes only, not the names
 
     return true;
 }
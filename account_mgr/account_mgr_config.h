@@ -39,6 +39,11 @@
 
 #define __CALLOC  heap_mgr_calloc
 #define __FREE    heap_mgr_free
+// Short lived allocations of one call (publish copy list), freed at once
+#define __ARENA_T         heap_mgr_arena_t
+#define __ARENA_INIT(arena, size) heap_mgr_arena_init((arena), heap_mgr_getDefault(), (size))
+#define __ARENA_ALLOC     heap_mgr_arena_malloc
+#define __ARENA_DESTROY   heap_mgr_arena_destroy
 
 
 